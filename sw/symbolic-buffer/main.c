@@ -0,0 +1,22 @@
+#include <assert.h>
+#include <stddef.h>
+
+extern void make_symbolic(volatile void *, size_t);
+
+// Buffers larger than a register are made symbolic byte-wise. The
+// assertion is only reached if the concrete value of every byte is
+// the one chosen by the solver, i.e. one path must fail it.
+static const char expected[16] = "symbolic buffer!";
+
+int main() {
+	char buf[16];
+
+	make_symbolic(buf, sizeof(buf));
+	for (size_t i = 0; i < sizeof(buf); i++) {
+		if (buf[i] != expected[i])
+			return 0;
+	}
+
+	assert(0);
+	return 0;
+}
@@ -25,6 +25,7 @@
 
 #include "clint_if.h"
 #include "irq_if.h"
+#include "snapshot_if.h"
 
 #include <tlm_utils/simple_target_socket.h>
 #include <systemc>
@@ -32,7 +33,7 @@
 #include "util/memory_map.h"
 
 template <unsigned NumberOfCores>
-struct CLINT : public clint_if, public sc_core::sc_module {
+struct CLINT : public clint_if, public snapshot_if, public sc_core::sc_module {
 	//
 	// core local interrupt controller (provides local timer interrupts with
 	// memory mapped configuration)
@@ -78,6 +79,11 @@ struct CLINT : public clint_if, public sc_core::sc_module {
 
 	std::array<clint_interrupt_target *, NumberOfCores> target_harts{};
 
+	// mtime is computed relative to this point in simulation time,
+	// moved forward on restore_state() to reset the timer.
+	sc_core::sc_time time_base = sc_core::SC_ZERO_TIME;
+	std::vector<std::vector<uint8_t>> saved_registers;
+
 	SC_HAS_PROCESS(CLINT);
 
 	CLINT(sc_core::sc_module_name) {
@@ -95,7 +101,7 @@ struct CLINT : public clint_if, public sc_core::sc_module {
 	}
 
 	uint64_t update_and_get_mtime() override {
-		auto now = sc_core::sc_time_stamp().value() / scaler;
+		auto now = (sc_core::sc_time_stamp() - time_base).value() / scaler;
 		if (now > mtime)
 			mtime = now;  // do not update backward in time (e.g. due to local quantums in tlm transaction processing)
 		return mtime;
@@ -130,7 +136,7 @@ struct CLINT : public clint_if, public sc_core::sc_module {
 	}
 
 	bool pre_read_mtime(RegisterRange::ReadInfo t) {
-		sc_core::sc_time now = sc_core::sc_time_stamp() + t.delay;
+		sc_core::sc_time now = (sc_core::sc_time_stamp() - time_base) + t.delay;
 
 		mtime.write(now.value() / scaler);
 
@@ -155,6 +161,21 @@ struct CLINT : public clint_if, public sc_core::sc_module {
 
 		vp::mm::route("CLINT", register_ranges, trans, delay);
 	}
+
+	void save_state() override {
+		saved_registers.clear();
+		for (auto range : register_ranges)
+			saved_registers.push_back(range->mem);
+	}
+
+	void restore_state() override {
+		assert(saved_registers.size() == register_ranges.size());
+		for (size_t i = 0; i < register_ranges.size(); i++)
+			register_ranges[i]->mem = saved_registers[i];
+
+		irq_event.cancel();
+		time_base = sc_core::sc_time_stamp();
+	}
 };
 
 #endif  // RISCV_ISA_CLINT_H
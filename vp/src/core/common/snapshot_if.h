@@ -0,0 +1,28 @@
+/*
+ * Copyright (c) 2021 Group of Computer Architecture, University of Bremen
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+/* Implemented by platform components whose state can be saved once
+ * (e.g. after the executable was loaded) and restored afterwards. This
+ * allows executing multiple paths without re-elaborating the platform. */
+struct snapshot_if {
+	virtual ~snapshot_if() {}
+
+	virtual void save_state() = 0;
+	virtual void restore_state() = 0;
+};
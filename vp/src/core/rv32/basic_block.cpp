@@ -16,33 +16,107 @@
  */
 
 #include <assert.h>
+#include <algorithm>
 #include <iostream>
+#include <stdexcept>
 
 #include "coverage.h"
 
 using namespace rv32;
 
-BasicBlockList::~BasicBlockList(void) {
-	for (size_t i = 0; i < blocks.size(); i++)
-		delete blocks[i];
+BasicBlock *BasicBlockList::add(uint64_t start, uint64_t end) {
+	blocks.emplace_back(start, end);
+	return &blocks.back();
 }
 
-BasicBlock *BasicBlockList::add(uint64_t start, uint64_t end) {
-	BasicBlock *block = new BasicBlock(start, end);
-	blocks.push_back(block);
+// Must be invoked once after all blocks have been added.
+void BasicBlockList::finalize(void) {
+	index.clear();
+	for (auto &block : blocks)
+		index.push_back(&block);
+
+	// For blocks with the same start address, the block added
+	// first is retained (i.e. the block of the first source).
+	std::stable_sort(index.begin(), index.end(), [](BasicBlock *a, BasicBlock *b) {
+		return a->start < b->start;
+	});
+	auto last = std::unique(index.begin(), index.end(), [](BasicBlock *a, BasicBlock *b) {
+		return a->start == b->start;
+	});
+	index.erase(last, index.end());
+
+	last_hit = nullptr;
+}
+
+BasicBlock *BasicBlockList::find(uint64_t addr) {
+	if (last_hit && addr >= last_hit->start && addr < last_hit->end)
+		return last_hit;
+
+	// Find the last block starting at or before the given address.
+	auto it = std::upper_bound(index.begin(), index.end(), addr, [](uint64_t addr, BasicBlock *block) {
+		return addr < block->start;
+	});
+	if (it == index.begin())
+		return nullptr;
+
+	BasicBlock *block = *(--it);
+	if (addr >= block->end)
+		return nullptr;
+
+	last_hit = block;
 	return block;
 }
 
-// TODO: Use binary search
+BasicBlock *BasicBlockList::at(size_t index) {
+	return &blocks.at(index);
+}
+
 void BasicBlockList::visit(uint64_t addr) {
-	for (auto block : blocks) {
-		if (addr >= block->start && addr < block->end) {
-			block->visited = true;
-			return;
-		}
+	BasicBlock *block = find(addr);
+	if (!block) {
+		std::cerr << "unknown block at: 0x" << std::hex << addr << std::endl;
+		return;
 	}
 
-	std::cerr << "unknown block at: 0x" << std::hex << addr << std::endl;
+	block->visited = true;
+}
+
+void BasicBlockList::dump(std::ostream &out) {
+	for (auto &block : blocks)
+		out.put(block.visited);
+}
+
+void BasicBlockList::merge(std::istream &in) {
+	for (auto &block : blocks) {
+		int visited = in.get();
+		if (visited == EOF)
+			throw std::runtime_error("truncated basic block coverage");
+		block.visited |= (visited != 0);
+	}
+}
+
+size_t BasicBlockList::unvisited(uint64_t start, uint64_t end) {
+	// Skip to the block containing start or the first block after it.
+	auto it = std::upper_bound(index.begin(), index.end(), start, [](uint64_t addr, BasicBlock *block) {
+		return addr < block->start;
+	});
+	if (it != index.begin() && (*std::prev(it))->end > start)
+		it--;
+
+	size_t unvisited = 0;
+	for (; it != index.end() && (*it)->start < end; it++) {
+		if (!(*it)->visited)
+			unvisited++;
+	}
+
+	return unvisited;
+}
+
+// Removes all blocks, only permitted before blocks are referenced.
+void BasicBlockList::clear(void) {
+	blocks.clear();
+	index.clear();
+	last_hit = nullptr;
 }
 
 size_t BasicBlockList::size(void) {
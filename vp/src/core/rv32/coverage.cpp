@@ -17,6 +17,7 @@
 
 #include "addr2line.h"
 #include "coverage.h"
+#include "coverage_dump.h"
 #include "instr.h"
 
 #include <assert.h>
@@ -26,7 +27,12 @@
 #include <inttypes.h>
 #include <stdbool.h>
 
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <functional>
 #include <fstream>
+#include <thread>
 #include <system_error>
 #include <iostream>
 #include <filesystem>
@@ -48,62 +54,88 @@ static const Dwfl_Callbacks offline_callbacks = (Dwfl_Callbacks){
 	.debuginfo_path = &debuginfo_path,
 };
 
-typedef enum {
-	INIT_BASIC_BLOCKS,
-	INIT_FUNCTIONS,
-} handler_type;
-
 struct Context {
 	Coverage *cov;
-	handler_type handler;
+	Coverage::CompUnit *unit;
 };
 
 #define ARCH RV32
-#define FORMAT_VERSION "1"
-#define GCC_VERSION "10.3.1 20210424"
 #define FILE_EXT ".gcov.json.gz"
 
+// Write JSON without indentation, reduces file size.
+#define COMPACT_ENV "SYMEX_COVERAGE_COMPACT"
+// Compression level for gzip, from 0 (none) to 9 (best).
+#define COMPRESSION_ENV "SYMEX_COVERAGE_COMPRESSION"
+// Write a binary dump to this file instead of gcov JSON files.
+#define DUMP_ENV "SYMEX_COVERAGE_DUMP"
+
+// Size of the edge map, must be a power of two.
+#define EDGE_MAP_SIZE (1 << 16)
+// Amount of bytes following a branch successor in which unvisited
+// basic blocks are counted, see unvisited_blocks.
+#define SCORE_WINDOW 64
+
 #define HAS_PREFIX(STR, PREFIX) \
 	(std::string(STR).find(PREFIX) == 0)
 
-Coverage::Coverage(std::string path) {
-	const char *fn = path.c_str();
+// A libdwfl session must not be used by multiple threads concurrently,
+// each thread resolving source information uses its own session.
+class rv32::DwarfSession {
+public:
+	int fd = -1;
+	Dwfl *dwfl = nullptr;
+	Dwfl_Module *mod = nullptr;
+
+	DwarfSession(const char *fn) {
+		if ((fd = open(fn, O_RDONLY)) == -1)
+			throw std::system_error(errno, std::generic_category());
+		if (!(dwfl = dwfl_begin(&offline_callbacks)))
+			throw_dwfl_error("dwfl_begin failed");
+
+		if (!(mod = dwfl_report_offline(dwfl, "", fn, fd)))
+			throw_dwfl_error("dwfl_report_offline failed");
+	}
 
-	if ((fd = open(fn, O_RDONLY)) == -1)
-		throw std::system_error(errno, std::generic_category());
-	if (!(dwfl = dwfl_begin(&offline_callbacks)))
-		throw_dwfl_error("dwfl_begin failed");
+	~DwarfSession(void) {
+		if (fd >= 0) {
+			close(fd);
+			fd = -1;
+		}
 
-	if (!(mod = dwfl_report_offline(dwfl, "", fn, fd)))
-		throw_dwfl_error("dwfl_report_offline failed");
-}
+		if (mod) {
+			dwfl_report_end(dwfl, NULL, NULL);
+			mod = nullptr;
+		}
 
-Coverage::~Coverage(void) {
-	if (fd >= 0) {
-		close(fd);
-		fd = -1;
+		if (dwfl) {
+			dwfl_end(dwfl);
+			dwfl = nullptr;
+		}
 	}
+};
 
-	if (mod) {
-		dwfl_report_end(dwfl, NULL, NULL);
-		mod = nullptr;
-	}
+Coverage::Coverage(std::string _path) : path(_path), edge_map(EDGE_MAP_SIZE, 0) {
+	session = std::make_unique<DwarfSession>(path.c_str());
+}
 
-	if (dwfl) {
-		dwfl_end(dwfl);
-		dwfl = nullptr;
-	}
+Coverage::~Coverage(void) {
+	wait_checkpoint();
 }
 
 /* https://en.wikipedia.org/wiki/Basic_block#Creation_algorithm */
 void
-Coverage::init_basic_blocks(uint64_t func_start, uint64_t func_end) {
+Coverage::init_basic_blocks(FuncRange &func) {
 	uint64_t addr;
+	uint64_t func_start = func.start;
+	uint64_t func_end = func.end;
 	bool prev_wasjump = false;
 
 	/* The first instruction is always a leader */
 	block_leaders[func_start] = true;
 
+	text_start = std::min(text_start, func_start);
+	text_end = std::max(text_end, func_end);
+
 	addr = func_start;
 	while (addr < func_end) {
 		// Instruction that immediately follows a (un)conditional jump/branch is a leader
@@ -111,6 +143,7 @@ Coverage::init_basic_blocks(uint64_t func_start, uint64_t func_end) {
 			block_leaders[addr] = true;
 		prev_wasjump = false;
 
+		func.instrs.push_back(addr);
 		uint32_t mem_word = instr_mem->load_instr(addr);
 		Instruction instr = Instruction(mem_word);
 
@@ -138,16 +171,86 @@ next:
 			addr += sizeof(uint32_t);
 		}
 	}
+
+	func.instrs.push_back(addr);
+}
+
+// Invokes the worker function on up to hardware_concurrency() threads
+// but not more than ntasks. The calling thread is used as worker 0.
+// Exceptions thrown by a worker are rethrown after all finished.
+static void
+run_workers(size_t ntasks, std::function<void(size_t)> worker) {
+	size_t nthreads = std::min((size_t)std::thread::hardware_concurrency(), ntasks);
+	nthreads = std::max(nthreads, (size_t)1);
+
+	std::vector<std::exception_ptr> errors(nthreads);
+	std::vector<std::thread> threads;
+	for (size_t t = 1; t < nthreads; t++) {
+		threads.emplace_back([t, &worker, &errors]() {
+			try {
+				worker(t);
+			} catch (...) {
+				errors[t] = std::current_exception();
+			}
+		});
+	}
+
+	try {
+		worker(0);
+	} catch (...) {
+		errors[0] = std::current_exception();
+	}
+
+	for (auto &thread : threads)
+		thread.join();
+	for (auto &error : errors) {
+		if (error)
+			std::rethrow_exception(error);
+	}
+}
+
+// Resolving the sources of an instruction is the most expensive part
+// of Coverage::init, it is therefore performed for multiple CUs in
+// parallel. Each thread writes only to the FuncRanges of its CUs.
+void
+Coverage::resolve_sources(std::vector<CompUnit> &units) {
+	std::atomic<size_t> next(0);
+	auto resolve = [&units, &next](Dwfl_Module *mod) {
+		size_t i;
+		while ((i = next++) < units.size()) {
+			for (auto &func : units[i]) {
+				for (size_t j = 0; j + 1 < func.instrs.size(); j++)
+					func.sources.push_back(get_sources(mod, func.instrs[j]));
+			}
+		}
+	};
+
+	run_workers(units.size(), [this, &resolve](size_t id) {
+		// The calling thread uses the session of this instance.
+		if (id == 0) {
+			resolve(session->mod);
+			return;
+		}
+
+		DwarfSession s(path.c_str());
+		resolve(s.mod);
+	});
 }
 
 void
-Coverage::add_func(uint64_t func_start, uint64_t func_end) {
-	std::vector<std::pair<Function*, SourceLine*>> prev;
-	uint64_t addr = func_start;
-	uint64_t block_prev = addr;
+Coverage::add_func(FuncRange &func) {
+	uint64_t func_end = func.end;
+	uint64_t block_prev = func.start;
 
-	while (addr < func_end) {
-		auto sources = get_sources(mod, addr);
+	assert(func.sources.size() + 1 == func.instrs.size());
+	for (size_t i = 0; i < func.sources.size(); i++) {
+		uint64_t addr = func.instrs[i];
+
+		InstrInfo *info = get_instr(addr);
+		assert(info);
+		info->sources.clear();
+
+		auto &sources = func.sources[i];
 		for (auto s : sources) {
 			if (s.symbol_name.empty() || s.source_path.empty())
 				assert(0);
@@ -177,16 +280,22 @@ Coverage::add_func(uint64_t func_start, uint64_t func_end) {
 				if (sl.definition.line > f.definition.second.line)
 					f.definition.second = sl.definition;
 			}
+
+			info->sources.push_back(std::make_pair(&f, &sl));
 		}
 
-		uint32_t mem_word = instr_mem->load_instr(addr);
-		Instruction instr = Instruction(mem_word);
-		if (instr.is_compressed()) {
-			addr += sizeof(uint16_t);
-		} else {
-			addr += sizeof(uint32_t);
+		Instruction instr = Instruction(instr_mem->load_instr(addr));
+		if (instr.opcode() == Opcode::OP_BEQ && !info->sources.empty()) {
+			info->branch = &branches.emplace_back();
+			info->branch->target = addr + instr.B_imm();
+			for (auto &source : info->sources) {
+				auto &lb = source.second->branches;
+				if (lb.empty() || lb.back() != info->branch)
+					lb.push_back(info->branch);
+			}
 		}
 
+		addr = func.instrs[i + 1];
 		bool block_start = block_leaders.count(addr) != 0;
 		if (block_start || addr == func_end) {
 			assert(block_prev < addr);
@@ -218,14 +327,8 @@ handle_func(Dwarf_Die *die, void *arg)
 		lopc += ctx->cov->bias;
 		hipc += ctx->cov->bias;
 
-		switch (ctx->handler) {
-		case INIT_BASIC_BLOCKS:
-			ctx->cov->init_basic_blocks(lopc, hipc);
-			break;
-		case INIT_FUNCTIONS:
-			ctx->cov->add_func(lopc, hipc);
-			break;
-		}
+		ctx->unit->emplace_back(lopc, hipc);
+		ctx->cov->init_basic_blocks(ctx->unit->back());
 	}
 
 	return DWARF_CB_OK;
@@ -257,32 +360,79 @@ Coverage::init(void) {
 	// leaders manually (through init_basic_blocks) first and then
 	// iterate over all instructoins (through add_func).
 
-	ctx.handler = INIT_BASIC_BLOCKS;
-	while ((cu = dwfl_module_nextcu(mod, cu, &bias)))
+	auto cache = cache_file();
+	if (cache.has_value() && load_cache(*cache))
+		return;
+
+	std::vector<CompUnit> units;
+	while ((cu = dwfl_module_nextcu(session->mod, cu, &bias))) {
+		units.emplace_back();
+		ctx.unit = &units.back();
 		dwarf_getfuncs(cu, handle_func, (void *)&ctx, 0);
+	}
 
-	bias = 0;
-	cu = nullptr;
+	if (text_start < text_end)
+		instrs.resize((text_end - text_start) / sizeof(uint16_t));
 
-	ctx.handler = INIT_FUNCTIONS;
-	while ((cu = dwfl_module_nextcu(mod, cu, &bias)))
-		dwarf_getfuncs(cu, handle_func, (void *)&ctx, 0);
+	resolve_sources(units);
+
+	// Merged in the original order, the order of basic blocks
+	// must be the same in all processes (see Coverage::dump).
+	for (auto &unit : units) {
+		for (auto &func : unit)
+			add_func(func);
+	}
+
+	// Basic blocks are immutable from now on, resolve the
+	// block of each instruction for use in Coverage::cover.
+	blocks.finalize();
+	for (size_t i = 0; i < instrs.size(); i++) {
+		if (!instrs[i].sources.empty())
+			instrs[i].block = blocks.find(text_start + i * sizeof(uint16_t));
+	}
+
+	if (cache.has_value())
+		save_cache(*cache);
 }
 
-void Coverage::cover(uint64_t addr, bool tainted, bool symbolic, bool init) {
-	auto sources = get_sources(mod, addr);
-	for (auto source : sources) {
-		if (files.count(source.source_path) == 0)
-			continue; /* assembler file */
+// Returns the GNU build-id of the executable as a hex string,
+// or an empty string if the executable does not have one.
+std::string
+Coverage::build_id(void) {
+	const unsigned char *bits;
+	GElf_Addr vaddr;
+
+	int len = dwfl_module_build_id(session->mod, &bits, &vaddr);
+	if (len <= 0)
+		return "";
+
+	std::string id;
+	for (int i = 0; i < len; i++) {
+		char buf[3];
+		snprintf(buf, sizeof(buf), "%02x", bits[i]);
+		id += buf;
+	}
+
+	return id;
+}
 
-		SourceFile &f = files.at(source.source_path);
+Coverage::InstrInfo *Coverage::get_instr(uint64_t addr) {
+	if (addr < text_start || addr >= text_end)
+		return nullptr;
+	return &instrs[(addr - text_start) / sizeof(uint16_t)];
+}
+
+void Coverage::cover(uint64_t addr, bool tainted, bool symbolic, bool init) {
+	InstrInfo *info = get_instr(addr);
+	if (!info || info->sources.empty())
+		return; /* e.g. assembler file */
 
-		Function &func = f.funcs.at(source.symbol_name);
+	for (auto &source : info->sources) {
+		Function &func = *source.first;
 		if (addr == func.first_instr)
 			func.exec_count++;
-		blocks.visit(addr);
 
-		SourceLine &sl = f.lines.at((unsigned int)source.line);
+		SourceLine &sl = *source.second;
 		if (addr == sl.first_instr)
 			sl.exec_count++;
 
@@ -293,42 +443,245 @@ void Coverage::cover(uint64_t addr, bool tainted, bool symbolic, bool init) {
 		if (init)
 			sl.initial_conc = true;
 	}
+
+	if (info->block && !info->block->visited) {
+		info->block->visited = true;
+		visited_changes++;
+	}
 }
 
-void Coverage::marshal(void) {
-	nlohmann::json j;
-	char *path_filter;
+Coverage::CoverPlan Coverage::prepare_cover(const std::vector<uint64_t> &addrs) {
+	CoverPlan plan;
+
+	for (auto addr : addrs) {
+		InstrInfo *info = get_instr(addr);
+		if (!info || info->sources.empty())
+			continue;
 
-	j["format_version"] = FORMAT_VERSION;
-	j["gcc_version"] = GCC_VERSION;
+		for (auto &source : info->sources) {
+			Function &func = *source.first;
+			if (addr == func.first_instr)
+				plan.counts.push_back(&func.exec_count);
 
-	j["files"] = nlohmann::json::array();
-	nlohmann::json &jfiles = j["files"];
+			SourceLine &sl = *source.second;
+			if (addr == sl.first_instr)
+				plan.counts.push_back(&sl.exec_count);
+		}
 
-	path_filter = getenv("SYMEX_COVERAGE_PATH");
+		if (info->block)
+			plan.blocks.push_back(info->block);
+	}
+
+	return plan;
+}
+
+void Coverage::cover_block(const CoverPlan &plan) {
+	for (auto count : plan.counts)
+		(*count)++;
+	for (auto block : plan.blocks) {
+		if (!block->visited) {
+			block->visited = true;
+			visited_changes++;
+		}
+	}
+}
+
+bool Coverage::is_leader(uint64_t addr) {
+	InstrInfo *info = get_instr(addr);
+	return info && info->block && info->block->start == addr;
+}
+
+// Instructions are at least two-byte aligned, the least significant
+// bit of both addresses is therefore discarded.
+static size_t
+edge_index(uint64_t from, uint64_t to) {
+	uint64_t hash = ((from >> 1) * 0x9E3779B97F4A7C15ULL) ^ (to >> 1);
+	return (hash ^ (hash >> 32)) & (EDGE_MAP_SIZE - 1);
+}
+
+void Coverage::cover_edge(uint64_t from, uint64_t to) {
+	uint8_t &count = edge_map[edge_index(from, to)];
+	if (count == 0)
+		new_edges++;
+	if (count < UINT8_MAX)
+		count++;
+}
+
+void Coverage::cover_branch(uint64_t addr, uint64_t target, bool taken) {
+	cover_edge(addr, target);
+
+	InstrInfo *info = get_instr(addr);
+	if (!info || !info->branch)
+		return;
+
+	if (taken)
+		info->branch->taken++;
+	else
+		info->branch->not_taken++;
+}
+
+size_t Coverage::path_new_edges(void) {
+	return new_edges;
+}
+
+void Coverage::begin_path(void) {
+	new_edges = 0;
+}
+
+size_t Coverage::unvisited_blocks(uint64_t addr, bool taken) {
+	InstrInfo *info = get_instr(addr);
+	if (!info || info->sources.empty())
+		return 0;
+
+	// Decisions which are not made by a conditional branch (e.g.
+	// division by zero) continue after the instruction either way.
+	uint64_t succ = addr;
+	if (info->branch)
+		succ = (taken) ? info->branch->target : addr + sizeof(uint32_t);
+
+	return blocks.unvisited(succ, succ + SCORE_WINDOW);
+}
+
+uint64_t Coverage::visited_version(void) {
+	return visited_changes;
+}
+
+static void
+write_count(std::ostream &out, uint64_t count) {
+	out.write((char *)&count, sizeof(count));
+}
+
+static uint64_t
+read_count(std::istream &in) {
+	uint64_t count;
+	if (!in.read((char *)&count, sizeof(count)))
+		throw std::runtime_error("truncated coverage information");
+	return count;
+}
+
+void Coverage::dump(std::ostream &out) {
 	for (auto &f : files) {
-		jfiles.clear();
-		auto path = std::filesystem::path(f.first);
+		SourceFile &file = f.second;
 
-		if (path_filter && !HAS_PREFIX(path, path_filter))
-			continue;
+		for (auto &l : file.lines) {
+			SourceLine &sl = l.second;
 
+			write_count(out, sl.exec_count);
+			out.put(sl.symbolic_once | sl.tainted_once << 1 | sl.initial_conc << 2);
+		}
+		for (auto &fn : file.funcs)
+			write_count(out, fn.second.exec_count);
+	}
+
+	blocks.dump(out);
+
+	for (auto &branch : branches) {
+		write_count(out, branch.taken);
+		write_count(out, branch.not_taken);
+	}
+	out.write((char *)edge_map.data(), edge_map.size());
+}
+
+void Coverage::merge(std::istream &in) {
+	for (auto &f : files) {
 		SourceFile &file = f.second;
-		file.to_json(jfiles);
 
-		j["data_file"] = path.filename();
-		j["current_working_directory"] = path.parent_path();
+		for (auto &l : file.lines) {
+			SourceLine &sl = l.second;
+
+			sl.exec_count += read_count(in);
+			int flags = in.get();
+			if (flags == EOF)
+				throw std::runtime_error("truncated coverage information");
 
-		auto fp = f.first + FILE_EXT;
-		std::ofstream fout(fp);
-		if (!fout.is_open())
-			throw std::runtime_error("failed to open " + std::string(fp));
+			sl.symbolic_once |= (flags & 1) != 0;
+			sl.tainted_once |= (flags & 2) != 0;
+			sl.initial_conc |= (flags & 4) != 0;
+		}
+		for (auto &fn : file.funcs)
+			fn.second.exec_count += read_count(in);
+	}
 
-		boost::iostreams::filtering_streambuf<boost::iostreams::output> gzstr;
-		gzstr.push(boost::iostreams::gzip_compressor());
-		gzstr.push(fout);
+	blocks.merge(in);
+	visited_changes++;
 
-		std::ostream out(&gzstr);
-		out << std::setw(4) << j << std::endl;
+	for (auto &branch : branches) {
+		branch.taken += read_count(in);
+		branch.not_taken += read_count(in);
 	}
+
+	std::vector<uint8_t> other(edge_map.size());
+	if (!in.read((char *)other.data(), other.size()))
+		throw std::runtime_error("truncated coverage information");
+	for (size_t i = 0; i < edge_map.size(); i++)
+		edge_map[i] = std::min((unsigned)edge_map[i] + other[i], (unsigned)UINT8_MAX);
+}
+
+void Coverage::marshal_file(SourceFile &file, unsigned indent, int level) {
+	auto path = std::filesystem::path(file.name);
+
+	auto fp = file.name + FILE_EXT;
+	std::ofstream fout(fp);
+	if (!fout.is_open())
+		throw std::runtime_error("failed to open " + std::string(fp));
+
+	boost::iostreams::filtering_streambuf<boost::iostreams::output> gzstr;
+	gzstr.push(boost::iostreams::gzip_compressor(boost::iostreams::gzip_params(level)));
+	gzstr.push(fout);
+
+	std::ostream out(&gzstr);
+	JsonWriter j(out, indent);
+
+	j.begin_object();
+	j.member("current_working_directory", path.parent_path().string());
+	j.member("data_file", path.filename().string());
+	j.key("files");
+	j.begin_array();
+	file.to_json(j);
+	j.end_array();
+	j.member("format_version", GCOV_FORMAT_VERSION);
+	j.member("gcc_version", GCOV_GCC_VERSION);
+	j.end_object();
+
+	out << std::endl;
+}
+
+void Coverage::marshal(void) {
+	char *path_filter;
+	unsigned indent;
+	int level;
+
+	wait_checkpoint();
+
+	char *dump = getenv(DUMP_ENV);
+	if (dump) {
+		write_dump(dump);
+		return;
+	}
+
+	path_filter = getenv("SYMEX_COVERAGE_PATH");
+	indent = (getenv(COMPACT_ENV)) ? 0 : 4;
+
+	level = boost::iostreams::gzip::default_compression;
+	char *compression = getenv(COMPRESSION_ENV);
+	if (compression) {
+		level = std::atoi(compression);
+		if (level < 0 || level > 9)
+			throw std::invalid_argument("invalid compression level: " + std::string(compression));
+	}
+
+	std::vector<SourceFile*> todo;
+	for (auto &f : files) {
+		if (path_filter && !HAS_PREFIX(f.first, path_filter))
+			continue;
+		todo.push_back(&f.second);
+	}
+
+	// Each file is written by a single thread.
+	std::atomic<size_t> next(0);
+	run_workers(todo.size(), [this, &todo, &next, indent, level](size_t) {
+		size_t i;
+		while ((i = next++) < todo.size())
+			marshal_file(*todo[i], indent, level);
+	});
 }
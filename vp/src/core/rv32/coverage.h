@@ -22,15 +22,22 @@
 #include <stddef.h>
 #include <stdbool.h>
 
+#include <deque>
+#include <filesystem>
 #include <map>
+#include <iostream>
 #include <string>
+#include <unordered_map>
 #include <memory>
+#include <optional>
+#include <thread>
 #include <vector>
 #include <utility>
 
-#include <nlohmann/json.hpp>
 #include <elfutils/libdwfl.h>
 
+#include "addr2line.h"
+#include "json_writer.h"
 #include "mem_if.h"
 #include "symbolic_context.h"
 
@@ -47,17 +54,39 @@ public:
 
 class BasicBlockList {
 private:
-	std::vector<BasicBlock*> blocks;
+	// Blocks are never removed, references to elements of the
+	// deque remain valid when new blocks are added.
+	std::deque<BasicBlock> blocks;
 
-public:
-	~BasicBlockList(void);
+	// Blocks sorted by start address, built by finalize().
+	std::vector<BasicBlock*> index;
+	BasicBlock *last_hit = nullptr;
 
+public:
 	BasicBlock *add(uint64_t start, uint64_t end);
+	void finalize(void);
+
+	BasicBlock *find(uint64_t addr);
+	BasicBlock *at(size_t index);
 	void visit(uint64_t addr);
 
+	void dump(std::ostream &);
+	void merge(std::istream &);
+
+	// Amount of unvisited blocks overlapping the given range.
+	size_t unvisited(uint64_t start, uint64_t end);
+
+	void clear(void);
 	size_t size(void);
 };
 
+// Execution counts of a conditional branch instruction.
+struct BranchCount {
+	uint64_t taken = 0;
+	uint64_t not_taken = 0;
+	uint64_t target = 0; // address of the taken successor
+};
+
 struct Function {
 public:
 	struct Location {
@@ -74,7 +103,7 @@ public:
 	uint64_t first_instr;
 	size_t exec_count = 0;
 
-	void to_json(nlohmann::json &);
+	void to_json(JsonWriter &);
 };
 
 class SourceLine {
@@ -84,6 +113,8 @@ public:
 
 	// References to BasicBlockList elements of Coverage.
 	std::vector<BasicBlock*> blocks;
+	// Conditional branches of this line, owned by Coverage.
+	std::vector<BranchCount*> branches;
 
 	uint64_t first_instr;
 	size_t exec_count = 0;
@@ -92,7 +123,7 @@ public:
 	bool tainted_once = false;
 	bool initial_conc = false;
 
-	void to_json(nlohmann::json &);
+	void to_json(JsonWriter &);
 };
 
 class SourceFile {
@@ -104,31 +135,148 @@ private:
 	std::map<int, SourceLine> lines;
 	std::map<std::string, Function> funcs;
 
-	void to_json(nlohmann::json &);
+	void to_json(JsonWriter &);
 };
 
+class DwarfSession;
+
 class Coverage {
-	int fd = -1;
-	Dwfl *dwfl = nullptr;
-	Dwfl_Module *mod = nullptr;
+	std::string path;
+	std::unique_ptr<DwarfSession> session;
 	BasicBlockList blocks;
 
 	std::map<uint64_t, bool> block_leaders;
 	std::map<std::string, SourceFile> files;
 
+	// Coverage information of a single instruction, resolved once
+	// during init() to avoid DWARF lookups in cover(). Contains one
+	// source for each effected source line (see get_sources).
+	struct InstrInfo {
+		BasicBlock *block = nullptr;
+		BranchCount *branch = nullptr; /* conditional branches only */
+		std::vector<std::pair<Function*, SourceLine*>> sources;
+	};
+
+	// Indexed by instruction address, starting at text_start, with
+	// a granularity of two bytes (i.e. compressed instructions).
+	uint64_t text_start = UINT64_MAX;
+	uint64_t text_end = 0;
+	std::vector<InstrInfo> instrs;
+
+	// Never removed, referenced by InstrInfo and SourceLine.
+	std::deque<BranchCount> branches;
+
+	// AFL-style edge coverage: each control flow transfer of a
+	// branch or jump instruction is hashed into a fixed-size map
+	// of saturating hit counters. Edges hit for the first time
+	// are counted in new_edges, which is reset for each path.
+	std::vector<uint8_t> edge_map;
+	size_t new_edges = 0;
+
+	// Incremented whenever the visited flag of a basic block may
+	// have changed, see visited_version.
+	uint64_t visited_changes = 0;
+
+	InstrInfo *get_instr(uint64_t addr);
+
+	// The model built by init() can be cached on disk, keyed by
+	// the build-id of the executable (see coverage_cache.cpp).
+	std::string build_id(void);
+	std::optional<std::filesystem::path> cache_file(void);
+	bool load_cache(std::filesystem::path);
+	void read_cache(std::istream &);
+	void save_cache(std::filesystem::path);
+
+	void marshal_file(SourceFile &, unsigned indent, int level);
+
+	// Copy of all execution counters, taken for a checkpoint (see
+	// coverage_checkpoint.cpp). Counters which are summed up when
+	// merging are stored in counts, all others in flags.
+	struct Counters {
+		std::vector<uint64_t> counts;
+		std::vector<uint8_t> flags;
+	};
+
+	// Checkpoints only contain counters which changed since the
+	// previous one and are written by a background thread.
+	Counters last_checkpoint;
+	bool checkpoint_started = false;
+	std::thread checkpoint_thread;
+
+	Counters snapshot(void);
+	void restore(const Counters &);
+	void wait_checkpoint(void);
+
 public:
 	Dwarf_Addr bias = 0;
 	instr_memory_if *instr_mem = nullptr;
 
+	// Function defined in a compilation unit (CU). Instruction
+	// addresses are collected by init_basic_blocks, the last
+	// element is the address after the last instruction. The
+	// sources of each instruction are resolved in parallel.
+	struct FuncRange {
+		uint64_t start, end;
+		std::vector<uint64_t> instrs;
+		std::vector<std::vector<SourceInfo>> sources;
+
+		FuncRange(uint64_t _start, uint64_t _end)
+			: start(_start), end(_end) {}
+	};
+	typedef std::vector<FuncRange> CompUnit;
+
 	Coverage(std::string path);
 	~Coverage(void);
 
 	void init(void);
-	void init_basic_blocks(uint64_t, uint64_t);
-	void add_func(uint64_t, uint64_t);
+	void init_basic_blocks(FuncRange &);
+	void resolve_sources(std::vector<CompUnit> &);
+	void add_func(FuncRange &);
 
 	void cover(uint64_t addr, bool tainted, bool symbolic, bool init);
+
+	// Counters updated by cover() for a sequence of instructions
+	// executed without symbolic operands. Resolved once by
+	// prepare_cover, applied by cover_block.
+	struct CoverPlan {
+		std::vector<size_t*> counts;
+		std::vector<BasicBlock*> blocks;
+	};
+	CoverPlan prepare_cover(const std::vector<uint64_t> &addrs);
+	void cover_block(const CoverPlan &);
+
+	// Whether the instruction at the given address is a basic
+	// block leader (see init_basic_blocks).
+	bool is_leader(uint64_t addr);
+	void cover_edge(uint64_t from, uint64_t to);
+	void cover_branch(uint64_t addr, uint64_t target, bool taken);
+
+	// Amount of edges which were first executed on the current path,
+	// i.e. since the last invocation of begin_path.
+	size_t path_new_edges(void);
+	void begin_path(void);
 	void marshal(void);
+	void write_dump(std::filesystem::path);
+
+	// Amount of basic blocks which have not been visited yet near
+	// the successor of the branch at the given address, for the
+	// given direction of the branch. Used to guide path exploration
+	// towards uncovered code. Scores only change if the value
+	// returned by visited_version changes.
+	size_t unvisited_blocks(uint64_t addr, bool taken);
+	uint64_t visited_version(void);
+
+	// Used to combine the coverage information of different
+	// worker processes, each of which must have been initialized
+	// for the same executable. The format is not stable.
+	void dump(std::ostream &);
+	void merge(std::istream &);
+
+	// Appends the counters changed since the last checkpoint to the
+	// given file. The file is truncated on the first checkpoint,
+	// unless counters have been restored from it using resume.
+	void checkpoint(std::filesystem::path, bool wait);
+	void resume(std::filesystem::path);
 };
 
 }
@@ -0,0 +1,363 @@
+/*
+ * Copyright (c) 2021 Group of Computer Architecture, University of Bremen
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <unordered_map>
+
+#include "coverage.h"
+
+using namespace rv32;
+
+// Directory in which the coverage model of executables is cached.
+// The cache is only used if this environment variable is set.
+#define CACHE_ENV "SYMEX_COVERAGE_CACHE"
+
+// Increment CACHE_VERSION on every change of the format below.
+#define CACHE_MAGIC "COVCACHE"
+#define CACHE_VERSION 3
+
+// The cache contains everything built by Coverage::init: basic
+// blocks in insertion order, the targets of conditional branches,
+// the SourceFile/Function/SourceLine skeletons (without execution
+// counts), and the instruction table.
+// Functions and lines are referenced by their position in a
+// traversal of the files map. The format is not portable.
+
+static void
+write_int(std::ostream &out, uint64_t value) {
+	out.write((char *)&value, sizeof(value));
+}
+
+static uint64_t
+read_int(std::istream &in) {
+	uint64_t value;
+	if (!in.read((char *)&value, sizeof(value)))
+		throw std::runtime_error("truncated coverage cache");
+	return value;
+}
+
+static void
+write_string(std::ostream &out, const std::string &str) {
+	write_int(out, str.size());
+	out.write(str.data(), str.size());
+}
+
+static std::string
+read_string(std::istream &in) {
+	std::string str(read_int(in), '\0');
+	if (!in.read(str.data(), str.size()))
+		throw std::runtime_error("truncated coverage cache");
+	return str;
+}
+
+static void
+write_location(std::ostream &out, const Function::Location &loc) {
+	write_int(out, (uint64_t)loc.line);
+	write_int(out, (uint64_t)loc.column);
+}
+
+static Function::Location
+read_location(std::istream &in) {
+	Function::Location loc;
+	loc.line = (int)read_int(in);
+	loc.column = (int)read_int(in);
+	return loc;
+}
+
+// FNV-1a hash of the file content, used as cache key for
+// executables which do not have a GNU build-id.
+static std::string
+content_hash(const std::string &path) {
+	std::ifstream file(path, std::ios::binary);
+	if (!file.is_open())
+		throw std::runtime_error("failed to open " + path);
+
+	uint64_t hash = 0xcbf29ce484222325ULL;
+	char buf[4096];
+	while (file.read(buf, sizeof(buf)) || file.gcount() > 0) {
+		for (std::streamsize i = 0; i < file.gcount(); i++) {
+			hash ^= (uint8_t)buf[i];
+			hash *= 0x100000001b3ULL;
+		}
+	}
+
+	char str[17];
+	snprintf(str, sizeof(str), "%016llx", (unsigned long long)hash);
+	return std::string(str);
+}
+
+std::optional<std::filesystem::path>
+Coverage::cache_file(void) {
+	char *dir = getenv(CACHE_ENV);
+	if (!dir)
+		return std::nullopt;
+
+	std::string key = build_id();
+	if (key.empty())
+		key = "content-" + content_hash(path);
+
+	return std::filesystem::path(dir) / (key + ".cache");
+}
+
+bool
+Coverage::load_cache(std::filesystem::path fp) {
+	std::ifstream in(fp, std::ios::binary);
+	if (!in.is_open())
+		return false;
+
+	char magic[sizeof(CACHE_MAGIC) - 1];
+	if (!in.read(magic, sizeof(magic)) || std::string(magic, sizeof(magic)) != CACHE_MAGIC)
+		return false;
+
+	try {
+		if (read_int(in) != CACHE_VERSION)
+			return false; /* created by a different version, rebuild it */
+		read_cache(in);
+	} catch (const std::exception &e) {
+		std::cerr << "WARNING: Ignoring invalid coverage cache " << fp << ": " << e.what() << std::endl;
+
+		// Discard the partially loaded model, rebuilt by init().
+		text_start = UINT64_MAX;
+		text_end = 0;
+		instrs.clear();
+		blocks.clear();
+		branches.clear();
+		files.clear();
+		return false;
+	}
+
+	return true;
+}
+
+// Reads the model following the header, throws on invalid input.
+void
+Coverage::read_cache(std::istream &in) {
+	text_start = read_int(in);
+	text_end = read_int(in);
+
+	uint64_t nblocks = read_int(in);
+	for (uint64_t i = 0; i < nblocks; i++) {
+		uint64_t start = read_int(in);
+		blocks.add(start, read_int(in));
+	}
+
+	uint64_t nbranches = read_int(in);
+	branches.resize(nbranches);
+	for (auto &branch : branches)
+		branch.target = read_int(in);
+
+	auto read_branch = [this, &in, nbranches](void) -> BranchCount* {
+		uint64_t idx = read_int(in);
+		if (idx == UINT64_MAX)
+			return nullptr;
+		else if (idx >= nbranches)
+			throw std::runtime_error("invalid branch in coverage cache");
+		return &branches[idx];
+	};
+
+	auto read_blocks = [this, &in, nblocks](std::vector<BasicBlock*> &out) {
+		uint64_t n = read_int(in);
+		for (uint64_t i = 0; i < n; i++) {
+			uint64_t idx = read_int(in);
+			if (idx >= nblocks)
+				throw std::runtime_error("invalid block in coverage cache");
+			out.push_back(blocks.at(idx));
+		}
+	};
+
+	std::vector<Function*> funcs;
+	std::vector<SourceLine*> lines;
+
+	uint64_t nfiles = read_int(in);
+	for (uint64_t i = 0; i < nfiles; i++) {
+		std::string name = read_string(in);
+		SourceFile &sf = files[name];
+		sf.name = name;
+
+		uint64_t nfuncs = read_int(in);
+		for (uint64_t j = 0; j < nfuncs; j++) {
+			std::string fname = read_string(in);
+			Function &f = sf.funcs[fname];
+			f.name = fname;
+			f.definition.first = read_location(in);
+			f.definition.second = read_location(in);
+			f.first_instr = read_int(in);
+			read_blocks(f.blocks);
+			funcs.push_back(&f);
+		}
+
+		uint64_t nlines = read_int(in);
+		for (uint64_t j = 0; j < nlines; j++) {
+			int line = (int)read_int(in);
+			SourceLine &sl = sf.lines[line];
+			sl.func_name = read_string(in);
+			sl.definition = read_location(in);
+			sl.first_instr = read_int(in);
+			read_blocks(sl.blocks);
+
+			uint64_t nlbranches = read_int(in);
+			for (uint64_t k = 0; k < nlbranches; k++)
+				sl.branches.push_back(read_branch());
+			lines.push_back(&sl);
+		}
+	}
+
+	if (text_start < text_end)
+		instrs.resize((text_end - text_start) / sizeof(uint16_t));
+
+	uint64_t ninstrs = read_int(in);
+	for (uint64_t i = 0; i < ninstrs; i++) {
+		InstrInfo &info = instrs.at(read_int(in));
+
+		uint64_t block = read_int(in);
+		info.block = (block < nblocks) ? blocks.at(block) : nullptr;
+		info.branch = read_branch();
+
+		uint64_t nsources = read_int(in);
+		for (uint64_t j = 0; j < nsources; j++) {
+			Function *f = funcs.at(read_int(in));
+			SourceLine *sl = lines.at(read_int(in));
+			info.sources.push_back(std::make_pair(f, sl));
+		}
+	}
+
+	blocks.finalize();
+}
+
+// The cache is written to a temporary file first and then renamed,
+// multiple processes may create the same cache file concurrently.
+void
+Coverage::save_cache(std::filesystem::path fp) {
+	auto tmp = fp;
+	tmp += ".tmp" + std::to_string(getpid());
+
+	std::ofstream out(tmp, std::ios::binary);
+	if (!out.is_open()) {
+		std::cerr << "WARNING: Failed to create coverage cache " << fp << std::endl;
+		return;
+	}
+
+	out.write(CACHE_MAGIC, sizeof(CACHE_MAGIC) - 1);
+	write_int(out, CACHE_VERSION);
+
+	write_int(out, text_start);
+	write_int(out, text_end);
+
+	std::unordered_map<BasicBlock*, uint64_t> block_ids;
+	write_int(out, blocks.size());
+	for (size_t i = 0; i < blocks.size(); i++) {
+		BasicBlock *block = blocks.at(i);
+		block_ids[block] = i;
+
+		write_int(out, block->start);
+		write_int(out, block->end);
+	}
+
+	std::unordered_map<BranchCount*, uint64_t> branch_ids;
+	write_int(out, branches.size());
+	for (size_t i = 0; i < branches.size(); i++) {
+		branch_ids[&branches[i]] = i;
+		write_int(out, branches[i].target);
+	}
+
+	auto write_branch = [&out, &branch_ids](BranchCount *branch) {
+		write_int(out, (branch) ? branch_ids.at(branch) : UINT64_MAX);
+	};
+
+	auto write_blocks = [&out, &block_ids](std::vector<BasicBlock*> &in) {
+		write_int(out, in.size());
+		for (auto block : in)
+			write_int(out, block_ids.at(block));
+	};
+
+	std::unordered_map<Function*, uint64_t> func_ids;
+	std::unordered_map<SourceLine*, uint64_t> line_ids;
+
+	write_int(out, files.size());
+	for (auto &file : files) {
+		SourceFile &sf = file.second;
+		write_string(out, file.first);
+
+		write_int(out, sf.funcs.size());
+		for (auto &fn : sf.funcs) {
+			Function &f = fn.second;
+			write_string(out, fn.first);
+			write_location(out, f.definition.first);
+			write_location(out, f.definition.second);
+			write_int(out, f.first_instr);
+			write_blocks(f.blocks);
+
+			size_t id = func_ids.size();
+			func_ids[&f] = id;
+		}
+
+		write_int(out, sf.lines.size());
+		for (auto &l : sf.lines) {
+			SourceLine &sl = l.second;
+			write_int(out, (uint64_t)l.first);
+			write_string(out, sl.func_name);
+			write_location(out, sl.definition);
+			write_int(out, sl.first_instr);
+			write_blocks(sl.blocks);
+
+			write_int(out, sl.branches.size());
+			for (auto branch : sl.branches)
+				write_branch(branch);
+
+			size_t id = line_ids.size();
+			line_ids[&sl] = id;
+		}
+	}
+
+	uint64_t ninstrs = 0;
+	for (auto &info : instrs) {
+		if (!info.sources.empty())
+			ninstrs++;
+	}
+
+	write_int(out, ninstrs);
+	for (size_t i = 0; i < instrs.size(); i++) {
+		InstrInfo &info = instrs[i];
+		if (info.sources.empty())
+			continue;
+
+		write_int(out, i);
+		write_int(out, (info.block) ? block_ids.at(info.block) : UINT64_MAX);
+		write_branch(info.branch);
+
+		write_int(out, info.sources.size());
+		for (auto &source : info.sources) {
+			write_int(out, func_ids.at(source.first));
+			write_int(out, line_ids.at(source.second));
+		}
+	}
+
+	out.close();
+	if (!out) {
+		std::cerr << "WARNING: Failed to write coverage cache " << fp << std::endl;
+		std::filesystem::remove(tmp);
+		return;
+	}
+
+	std::filesystem::rename(tmp, fp);
+}
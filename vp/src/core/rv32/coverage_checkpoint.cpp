@@ -0,0 +1,242 @@
+/*
+ * Copyright (c) 2021 Group of Computer Architecture, University of Bremen
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+
+#include "coverage.h"
+
+using namespace rv32;
+
+// A checkpoint file starts with a header containing the amount of
+// counts and flags, followed by records. Each record contains the
+// indices and new values of all counters which changed since the
+// previous record. Records are prefixed with their size, a record
+// truncated by a terminated process is ignored on resume.
+#define CHECKPOINT_MAGIC "COVCKPT"
+
+static void
+write_int(std::ostream &out, uint64_t value) {
+	out.write((char *)&value, sizeof(value));
+}
+
+static bool
+read_int(std::istream &in, uint64_t &value) {
+	return (bool)in.read((char *)&value, sizeof(value));
+}
+
+// Counters are stored in the same order as by Coverage::dump.
+Coverage::Counters
+Coverage::snapshot(void) {
+	Counters c;
+
+	for (auto &f : files) {
+		SourceFile &file = f.second;
+
+		for (auto &l : file.lines) {
+			SourceLine &sl = l.second;
+
+			c.counts.push_back(sl.exec_count);
+			c.flags.push_back(sl.symbolic_once | sl.tainted_once << 1 | sl.initial_conc << 2);
+		}
+		for (auto &fn : file.funcs)
+			c.counts.push_back(fn.second.exec_count);
+	}
+
+	for (auto &branch : branches) {
+		c.counts.push_back(branch.taken);
+		c.counts.push_back(branch.not_taken);
+	}
+
+	for (size_t i = 0; i < blocks.size(); i++)
+		c.flags.push_back(blocks.at(i)->visited);
+	c.flags.insert(c.flags.end(), edge_map.begin(), edge_map.end());
+
+	return c;
+}
+
+void
+Coverage::restore(const Counters &c) {
+	size_t ci = 0, fi = 0;
+
+	for (auto &f : files) {
+		SourceFile &file = f.second;
+
+		for (auto &l : file.lines) {
+			SourceLine &sl = l.second;
+
+			sl.exec_count = c.counts.at(ci++);
+			uint8_t flags = c.flags.at(fi++);
+			sl.symbolic_once = (flags & 1) != 0;
+			sl.tainted_once = (flags & 2) != 0;
+			sl.initial_conc = (flags & 4) != 0;
+		}
+		for (auto &fn : file.funcs)
+			fn.second.exec_count = c.counts.at(ci++);
+	}
+
+	for (auto &branch : branches) {
+		branch.taken = c.counts.at(ci++);
+		branch.not_taken = c.counts.at(ci++);
+	}
+
+	for (size_t i = 0; i < blocks.size(); i++)
+		blocks.at(i)->visited = c.flags.at(fi++) != 0;
+	visited_changes++;
+	for (auto &count : edge_map)
+		count = c.flags.at(fi++);
+}
+
+template <typename T>
+static void
+write_changes(std::ostream &out, const std::vector<T> &prev, const std::vector<T> &cur) {
+	std::vector<size_t> changed;
+	for (size_t i = 0; i < cur.size(); i++) {
+		if (prev.empty() || prev[i] != cur[i])
+			changed.push_back(i);
+	}
+
+	write_int(out, changed.size());
+	for (auto i : changed) {
+		write_int(out, i);
+		write_int(out, cur[i]);
+	}
+}
+
+template <typename T>
+static bool
+read_changes(std::istream &in, std::vector<T> &cur) {
+	uint64_t n;
+	if (!read_int(in, n))
+		return false;
+
+	for (uint64_t i = 0; i < n; i++) {
+		uint64_t index, value;
+		if (!read_int(in, index) || !read_int(in, value))
+			return false;
+		if (index >= cur.size())
+			throw std::runtime_error("invalid index in coverage checkpoint");
+		cur[index] = (T)value;
+	}
+
+	return true;
+}
+
+static void
+write_checkpoint(std::filesystem::path fp, bool truncate,
+		const std::vector<uint64_t> &prev_counts, const std::vector<uint64_t> &counts,
+		const std::vector<uint8_t> &prev_flags, const std::vector<uint8_t> &flags) {
+	std::ostringstream record;
+	write_changes(record, prev_counts, counts);
+	write_changes(record, prev_flags, flags);
+
+	auto mode = std::ios::binary | ((truncate) ? std::ios::trunc : std::ios::app);
+	std::ofstream out(fp, mode);
+	if (!out.is_open())
+		throw std::runtime_error("failed to open " + fp.string());
+
+	if (truncate) {
+		out.write(CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC));
+		write_int(out, counts.size());
+		write_int(out, flags.size());
+	}
+
+	std::string data = record.str();
+	write_int(out, data.size());
+	out.write(data.data(), data.size());
+
+	out.close();
+	if (!out)
+		throw std::runtime_error("failed to write " + fp.string());
+}
+
+void
+Coverage::wait_checkpoint(void) {
+	if (checkpoint_thread.joinable())
+		checkpoint_thread.join();
+}
+
+// The counters are copied by the calling thread, which is the only
+// thread modifying them. Determining the changes and writing them
+// is performed by a background thread.
+void
+Coverage::checkpoint(std::filesystem::path fp, bool wait) {
+	wait_checkpoint();
+
+	Counters cur = snapshot();
+	Counters prev = std::move(last_checkpoint);
+	last_checkpoint = cur;
+
+	bool truncate = !checkpoint_started;
+	checkpoint_started = true;
+
+	checkpoint_thread = std::thread([fp, truncate, prev = std::move(prev), cur = std::move(cur)]() {
+		try {
+			write_checkpoint(fp, truncate, prev.counts, cur.counts, prev.flags, cur.flags);
+		} catch (const std::exception &e) {
+			std::cerr << "WARNING: Failed to write coverage checkpoint: " << e.what() << std::endl;
+		}
+	});
+
+	if (wait)
+		wait_checkpoint();
+}
+
+void
+Coverage::resume(std::filesystem::path fp) {
+	std::ifstream in(fp, std::ios::binary);
+	if (!in.is_open()) {
+		std::cerr << "WARNING: No coverage checkpoint at " << fp << std::endl;
+		return;
+	}
+
+	Counters c = snapshot();
+	char magic[sizeof(CHECKPOINT_MAGIC)];
+	uint64_t ncounts, nflags;
+	if (!in.read(magic, sizeof(magic)) || memcmp(magic, CHECKPOINT_MAGIC, sizeof(magic)) ||
+			!read_int(in, ncounts) || !read_int(in, nflags))
+		throw std::runtime_error(fp.string() + ": not a coverage checkpoint");
+	if (ncounts != c.counts.size() || nflags != c.flags.size())
+		throw std::runtime_error(fp.string() + ": checkpoint of a different executable");
+
+	uint64_t size;
+	std::streamoff valid = in.tellg();
+	while (read_int(in, size)) {
+		std::string data(size, '\0');
+		if (!in.read(data.data(), size))
+			break; /* truncated record, ignore it */
+
+		std::istringstream record(data);
+		if (!read_changes(record, c.counts) || !read_changes(record, c.flags))
+			throw std::runtime_error(fp.string() + ": invalid coverage checkpoint");
+		valid = in.tellg();
+	}
+	in.close();
+
+	// Remove a truncated record, new records are appended.
+	std::filesystem::resize_file(fp, valid);
+	restore(c);
+
+	// Further checkpoints are appended to the existing file.
+	last_checkpoint = std::move(c);
+	checkpoint_started = true;
+}
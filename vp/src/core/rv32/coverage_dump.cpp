@@ -0,0 +1,338 @@
+/*
+ * Copyright (c) 2021 Group of Computer Architecture, University of Bremen
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <filesystem>
+#include <stdexcept>
+#include <system_error>
+
+#include "coverage_dump.h"
+
+using namespace rv32;
+
+CoverageDump::CoverageDump(const std::string &_path) : path(_path) {
+	int fd = open(path.c_str(), O_RDONLY);
+	if (fd == -1)
+		throw std::system_error(errno, std::generic_category(), path);
+
+	struct stat st;
+	if (fstat(fd, &st) == -1) {
+		close(fd);
+		throw std::system_error(errno, std::generic_category(), path);
+	}
+	size = st.st_size;
+	if (size < sizeof(DumpHeader)) {
+		close(fd);
+		throw std::runtime_error(path + ": not a coverage dump");
+	}
+
+	// Private writable mapping, allows merging other dumps into it.
+	void *addr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (addr == MAP_FAILED)
+		throw std::system_error(errno, std::generic_category(), path);
+	data = (uint8_t *)addr;
+
+	try {
+		validate();
+	} catch (...) {
+		munmap(data, size);
+		throw;
+	}
+}
+
+CoverageDump::~CoverageDump(void) {
+	munmap(data, size);
+}
+
+void
+CoverageDump::validate(void) {
+	const DumpHeader &h = header();
+	if (memcmp(h.magic, DUMP_MAGIC, sizeof(DUMP_MAGIC)))
+		throw std::runtime_error(path + ": not a coverage dump");
+	if (h.version != DUMP_VERSION)
+		throw std::runtime_error(path + ": unsupported dump version " + std::to_string(h.version));
+	if (h.size != size)
+		throw std::runtime_error(path + ": truncated coverage dump");
+
+	auto check = [this](uint64_t offset, uint64_t n, size_t elem_size) {
+		if (offset % 8 || offset > size || n > (size - offset) / elem_size)
+			throw std::runtime_error(path + ": invalid section in coverage dump");
+	};
+	check(h.files, h.nfiles, sizeof(DumpFile));
+	check(h.funcs, h.nfuncs, sizeof(DumpFunction));
+	check(h.lines, h.nlines, sizeof(DumpLine));
+	check(h.refs, h.nrefs, sizeof(uint64_t));
+	check(h.strtab, h.strtab_size, sizeof(char));
+	check(h.func_counts, h.nfuncs, sizeof(uint64_t));
+	check(h.line_counts, h.nlines, sizeof(uint64_t));
+	check(h.line_flags, h.nlines, sizeof(uint8_t));
+	check(h.block_bitmap, (h.nblocks + 63) / 64, sizeof(uint64_t));
+	check(h.branch_counts, h.nbranches, 2 * sizeof(uint64_t));
+
+	if (h.strtab_size > 0 && data[h.strtab + h.strtab_size - 1] != '\0')
+		throw std::runtime_error(path + ": invalid strtab in coverage dump");
+
+	// References are checked once here, not on every access.
+	auto check_refs = [this, &h](uint64_t first, uint64_t n, uint64_t max) {
+		if (first > h.nrefs || n > h.nrefs - first)
+			throw std::runtime_error(path + ": invalid reference in coverage dump");
+
+		auto refs = section<uint64_t>(h.refs) + first;
+		for (uint64_t i = 0; i < n; i++) {
+			if (refs[i] >= max)
+				throw std::runtime_error(path + ": invalid reference in coverage dump");
+		}
+	};
+	auto check_string = [this, &h](uint64_t offset) {
+		if (offset >= h.strtab_size)
+			throw std::runtime_error(path + ": invalid string in coverage dump");
+	};
+
+	auto files = section<DumpFile>(h.files);
+	for (uint64_t i = 0; i < h.nfiles; i++) {
+		check_string(files[i].name);
+		if (files[i].first_func > h.nfuncs || files[i].nfuncs > h.nfuncs - files[i].first_func ||
+				files[i].first_line > h.nlines || files[i].nlines > h.nlines - files[i].first_line)
+			throw std::runtime_error(path + ": invalid file in coverage dump");
+	}
+
+	auto funcs = section<DumpFunction>(h.funcs);
+	for (uint64_t i = 0; i < h.nfuncs; i++) {
+		check_string(funcs[i].name);
+		check_refs(funcs[i].first_block, funcs[i].nblocks, h.nblocks);
+	}
+
+	auto lines = section<DumpLine>(h.lines);
+	for (uint64_t i = 0; i < h.nlines; i++) {
+		check_string(lines[i].func_name);
+		check_refs(lines[i].first_block, lines[i].nblocks, h.nblocks);
+		check_refs(lines[i].first_branch, lines[i].nbranches, h.nbranches);
+	}
+}
+
+const char *
+CoverageDump::string(uint64_t offset) const {
+	return section<char>(header().strtab) + offset;
+}
+
+bool
+CoverageDump::visited(uint64_t block) const {
+	auto bitmap = section<uint64_t>(header().block_bitmap);
+	return (bitmap[block / 64] >> (block % 64)) & 1;
+}
+
+size_t
+CoverageDump::visited(const uint64_t *refs, uint64_t n) const {
+	size_t count = 0;
+	for (uint64_t i = 0; i < n; i++) {
+		if (visited(refs[i]))
+			count++;
+	}
+
+	return count;
+}
+
+void
+CoverageDump::merge(const CoverageDump &other) {
+	const DumpHeader &h = header();
+	const DumpHeader &o = other.header();
+
+	// All structure sections are compared, not only their hash.
+	size_t len = h.strtab + h.strtab_size - h.files;
+	if (h.structure_hash != o.structure_hash || h.files != o.files ||
+			h.strtab != o.strtab || h.strtab_size != o.strtab_size ||
+			memcmp(data + h.files, other.data + o.files, len))
+		throw std::runtime_error(other.path + ": coverage dump of a different executable");
+
+	auto add = [this, &other](uint64_t offset, uint64_t other_offset, uint64_t n) {
+		auto dst = section<uint64_t>(offset);
+		auto src = other.section<uint64_t>(other_offset);
+		for (uint64_t i = 0; i < n; i++)
+			dst[i] += src[i];
+	};
+	add(h.func_counts, o.func_counts, h.nfuncs);
+	add(h.line_counts, o.line_counts, h.nlines);
+	add(h.branch_counts, o.branch_counts, 2 * h.nbranches);
+
+	auto flags = section<uint8_t>(h.line_flags);
+	auto other_flags = other.section<uint8_t>(o.line_flags);
+	for (uint64_t i = 0; i < h.nlines; i++)
+		flags[i] |= other_flags[i];
+
+	auto bitmap = section<uint64_t>(h.block_bitmap);
+	auto other_bitmap = other.section<uint64_t>(o.block_bitmap);
+	for (uint64_t i = 0; i < (h.nblocks + 63) / 64; i++)
+		bitmap[i] |= other_bitmap[i];
+}
+
+void
+CoverageDump::write(std::ostream &out) const {
+	out.write((char *)data, size);
+}
+
+// Each conditional branch has two arcs in the gcov format.
+void
+CoverageDump::branches_to_gcov(JsonWriter &out, const DumpLine &line) const {
+	const DumpHeader &h = header();
+	auto refs = section<uint64_t>(h.refs);
+	auto branch_counts = section<uint64_t>(h.branch_counts);
+
+	out.key("branches");
+	out.begin_array();
+	for (uint64_t i = 0; i < line.nbranches; i++) {
+		auto branch = branch_counts + 2 * refs[line.first_branch + i];
+
+		out.begin_object();
+		out.member("count", branch[1]);
+		out.member("fallthrough", true);
+		out.member("throw", false);
+		out.end_object();
+
+		out.begin_object();
+		out.member("count", branch[0]);
+		out.member("fallthrough", false);
+		out.member("throw", false);
+		out.end_object();
+	}
+	out.end_array();
+}
+
+// Keys are written in the same order as by SourceLine::to_json,
+// Function::to_json, and SourceFile::to_json (see json.cpp).
+
+void
+CoverageDump::line_to_gcov(JsonWriter &out, const DumpLine &line, uint64_t index) const {
+	const DumpHeader &h = header();
+	auto refs = section<uint64_t>(h.refs);
+	auto counts = section<uint64_t>(h.line_counts);
+	auto flags = section<uint8_t>(h.line_flags)[index];
+
+	out.begin_object();
+	branches_to_gcov(out, line);
+	out.member("count", counts[index]);
+	out.member("function_name", string(line.func_name));
+	out.member("line_number", line.line);
+	out.member("symex/initial_concretization", (flags & DUMP_LINE_INITIAL_CONC) != 0);
+	out.member("symex/symbolic_once", (flags & DUMP_LINE_SYMBOLIC) != 0);
+	out.member("symex/tainted_once", (flags & DUMP_LINE_TAINTED) != 0);
+	out.member("unexecuted_block", counts[index] == 0 ||
+		visited(refs + line.first_block, line.nblocks) != line.nblocks);
+	out.end_object();
+}
+
+void
+CoverageDump::func_to_gcov(JsonWriter &out, const DumpFunction &func, uint64_t index) const {
+	const DumpHeader &h = header();
+	auto refs = section<uint64_t>(h.refs);
+	auto counts = section<uint64_t>(h.func_counts);
+
+	out.begin_object();
+	out.member("blocks", func.nblocks);
+	out.member("blocks_executed", (uint64_t)visited(refs + func.first_block, func.nblocks));
+	out.member("demangled_name", string(func.name));
+	out.member("end_column", func.end_column);
+	out.member("end_line", func.end_line);
+	out.member("execution_count", counts[index]);
+	out.member("name", string(func.name));
+	out.member("start_column", func.start_column);
+	out.member("start_line", func.start_line);
+	out.end_object();
+}
+
+void
+CoverageDump::to_gcov(JsonWriter &out, const std::string &prefix) const {
+	const DumpHeader &h = header();
+	auto files = section<DumpFile>(h.files);
+	auto funcs = section<DumpFunction>(h.funcs);
+	auto lines = section<DumpLine>(h.lines);
+
+	out.begin_object();
+	out.member("current_working_directory", std::filesystem::current_path().string());
+	out.member("data_file", path);
+	out.key("files");
+	out.begin_array();
+	for (uint64_t i = 0; i < h.nfiles; i++) {
+		const DumpFile &file = files[i];
+		std::string name = string(file.name);
+		if (name.find(prefix) != 0)
+			continue;
+
+		out.begin_object();
+		out.member("file", std::filesystem::path(name).filename().string());
+		out.key("functions");
+		out.begin_array();
+		for (uint64_t j = file.first_func; j < file.first_func + file.nfuncs; j++)
+			func_to_gcov(out, funcs[j], j);
+		out.end_array();
+		out.key("lines");
+		out.begin_array();
+		for (uint64_t j = file.first_line; j < file.first_line + file.nlines; j++)
+			line_to_gcov(out, lines[j], j);
+		out.end_array();
+		out.end_object();
+	}
+	out.end_array();
+	out.member("format_version", GCOV_FORMAT_VERSION);
+	out.member("gcc_version", GCOV_GCC_VERSION);
+	out.end_object();
+}
+
+// Same output as contrib/to_gcovr.py for the gcov JSON files.
+void
+CoverageDump::to_gcovr(JsonWriter &out, const std::string &prefix) const {
+	const DumpHeader &h = header();
+	auto files = section<DumpFile>(h.files);
+	auto lines = section<DumpLine>(h.lines);
+	auto counts = section<uint64_t>(h.line_counts);
+
+	out.begin_object();
+	out.member("gcovr/format_version", 0.1);
+	out.key("files");
+	out.begin_array();
+	for (uint64_t i = 0; i < h.nfiles; i++) {
+		const DumpFile &file = files[i];
+		std::string name = string(file.name);
+		if (name.find(prefix) != 0)
+			continue;
+
+		out.begin_object();
+		out.member("file", std::filesystem::path(name).filename().string());
+		out.key("lines");
+		out.begin_array();
+		for (uint64_t j = file.first_line; j < file.first_line + file.nlines; j++) {
+			const DumpLine &line = lines[j];
+
+			out.begin_object();
+			branches_to_gcov(out, line);
+			out.member("count", counts[j]);
+			out.member("line_number", line.line);
+			out.member("gcovr/noncode", false);
+			out.end_object();
+		}
+		out.end_array();
+		out.end_object();
+	}
+	out.end_array();
+	out.end_object();
+}
@@ -0,0 +1,153 @@
+/*
+ * Copyright (c) 2021 Group of Computer Architecture, University of Bremen
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef RISCV_VP_COVERAGE_DUMP_H
+#define RISCV_VP_COVERAGE_DUMP_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <ostream>
+#include <string>
+
+#include "json_writer.h"
+
+namespace rv32 {
+
+// Binary coverage dump, written by Coverage::write_dump. The file is
+// designed to be used through mmap(2): it consists of a header and
+// sections of fixed-size records, all aligned to eight bytes. The
+// structure sections (files to strtab) describe the source code of
+// an executable and are identical for all dumps of it. The counter
+// sections contain the results of the execution and are combined
+// element-wise when merging dumps. The format is not portable.
+
+// Version information included in the generated gcov JSON.
+#define GCOV_FORMAT_VERSION "1"
+#define GCOV_GCC_VERSION "10.3.1 20210424"
+
+#define DUMP_MAGIC "COVDUMP"
+#define DUMP_VERSION 1
+
+// Flags of DumpHeader::line_flags, same as in Coverage::dump.
+#define DUMP_LINE_SYMBOLIC (1 << 0)
+#define DUMP_LINE_TAINTED (1 << 1)
+#define DUMP_LINE_INITIAL_CONC (1 << 2)
+
+struct DumpHeader {
+	char magic[8];
+	uint64_t version;
+
+	// FNV-1a hash of the structure sections.
+	uint64_t structure_hash;
+
+	uint64_t nfiles;
+	uint64_t nfuncs;
+	uint64_t nlines;
+	uint64_t nblocks;
+	uint64_t nbranches;
+	uint64_t nrefs;
+	uint64_t strtab_size;
+
+	// Offsets of the sections relative to the start of the file.
+	// Structure sections, in this order and without gaps.
+	uint64_t files;    /* DumpFile[nfiles] */
+	uint64_t funcs;    /* DumpFunction[nfuncs] */
+	uint64_t lines;    /* DumpLine[nlines] */
+	uint64_t refs;     /* uint64_t[nrefs] */
+	uint64_t strtab;   /* char[strtab_size] */
+
+	// Counter sections.
+	uint64_t func_counts;   /* uint64_t[nfuncs] */
+	uint64_t line_counts;   /* uint64_t[nlines] */
+	uint64_t line_flags;    /* uint8_t[nlines] */
+	uint64_t block_bitmap;  /* uint64_t[(nblocks + 63) / 64] */
+	uint64_t branch_counts; /* uint64_t[nbranches][2], taken first */
+
+	uint64_t size;
+};
+
+// Names are offsets of NUL-terminated strings in the strtab.
+// Blocks and branches of functions and lines are referenced
+// through a range of the refs section, which contains indices.
+
+struct DumpFile {
+	uint64_t name;
+	uint64_t first_func, nfuncs;
+	uint64_t first_line, nlines;
+};
+
+struct DumpFunction {
+	uint64_t name;
+	int32_t start_line, start_column;
+	int32_t end_line, end_column;
+	uint64_t first_block, nblocks;
+};
+
+struct DumpLine {
+	uint64_t func_name;
+	int32_t line, column;
+	uint64_t first_block, nblocks;
+	uint64_t first_branch, nbranches;
+};
+
+// Read-only view of a dump file, mapped privately. Counters of other
+// dumps can be added to the mapping without modifying the file.
+class CoverageDump {
+private:
+	std::string path;
+	uint8_t *data = nullptr;
+	size_t size = 0;
+
+	template <typename T>
+	T *section(uint64_t offset) const {
+		return (T *)(data + offset);
+	}
+
+	void validate(void);
+	const char *string(uint64_t offset) const;
+	bool visited(uint64_t block) const;
+	size_t visited(const uint64_t *refs, uint64_t n) const;
+
+	void branches_to_gcov(JsonWriter &, const DumpLine &) const;
+	void line_to_gcov(JsonWriter &, const DumpLine &, uint64_t index) const;
+	void func_to_gcov(JsonWriter &, const DumpFunction &, uint64_t index) const;
+
+public:
+	CoverageDump(const std::string &path);
+	~CoverageDump(void);
+
+	CoverageDump(const CoverageDump &) = delete;
+	CoverageDump &operator=(const CoverageDump &) = delete;
+
+	const DumpHeader &header(void) const {
+		return *(DumpHeader *)data;
+	}
+
+	// Adds the counters of the given dump to this one, both
+	// must have been created for the same executable.
+	void merge(const CoverageDump &);
+	void write(std::ostream &) const;
+
+	// Only source files with the given path prefix are converted.
+	void to_gcov(JsonWriter &, const std::string &prefix) const;
+	void to_gcovr(JsonWriter &, const std::string &prefix) const;
+};
+
+}
+
+#endif
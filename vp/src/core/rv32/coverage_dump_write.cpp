@@ -0,0 +1,200 @@
+/*
+ * Copyright (c) 2021 Group of Computer Architecture, University of Bremen
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <unordered_map>
+#include <vector>
+
+#include "coverage.h"
+#include "coverage_dump.h"
+
+using namespace rv32;
+
+// Creation of a coverage dump from the coverage model, see
+// coverage_dump.h for the file format. Kept separate from the
+// reader, which is also used by offline tools (e.g. covmerge).
+
+#define ALIGN(SIZE) (((SIZE) + 7) & ~(uint64_t)7)
+
+static uint64_t
+fnv1a(const uint8_t *data, size_t size) {
+	uint64_t hash = 0xcbf29ce484222325ULL;
+	for (size_t i = 0; i < size; i++) {
+		hash ^= data[i];
+		hash *= 0x100000001b3ULL;
+	}
+
+	return hash;
+}
+
+// Appends n elements to the buffer, padded to eight bytes.
+// Returns the offset of the first element in the buffer.
+template <typename T>
+static uint64_t
+append(std::vector<uint8_t> &buf, const T *elems, size_t n) {
+	uint64_t offset = buf.size();
+
+	auto bytes = (const uint8_t *)elems;
+	buf.insert(buf.end(), bytes, bytes + n * sizeof(T));
+	buf.resize(ALIGN(buf.size()), 0);
+
+	return offset;
+}
+
+void
+Coverage::write_dump(std::filesystem::path fp) {
+	std::unordered_map<BasicBlock*, uint64_t> block_ids;
+	std::vector<uint64_t> bitmap((blocks.size() + 63) / 64, 0);
+	for (size_t i = 0; i < blocks.size(); i++) {
+		BasicBlock *block = blocks.at(i);
+		block_ids[block] = i;
+		if (block->visited)
+			bitmap[i / 64] |= (uint64_t)1 << (i % 64);
+	}
+
+	std::unordered_map<BranchCount*, uint64_t> branch_ids;
+	std::vector<uint64_t> branch_counts;
+	for (size_t i = 0; i < branches.size(); i++) {
+		branch_ids[&branches[i]] = i;
+		branch_counts.push_back(branches[i].taken);
+		branch_counts.push_back(branches[i].not_taken);
+	}
+
+	std::string strtab;
+	std::unordered_map<std::string, uint64_t> strings;
+	auto add_string = [&strtab, &strings](const std::string &str) {
+		auto it = strings.find(str);
+		if (it != strings.end())
+			return it->second;
+
+		uint64_t offset = strtab.size();
+		strtab.append(str.c_str(), str.size() + 1);
+		strings[str] = offset;
+		return offset;
+	};
+
+	std::vector<uint64_t> refs;
+	auto add_refs = [&refs](std::vector<uint64_t> ids, uint64_t &first, uint64_t &n) {
+		first = refs.size();
+		n = ids.size();
+		refs.insert(refs.end(), ids.begin(), ids.end());
+	};
+
+	std::vector<DumpFile> dfiles;
+	std::vector<DumpFunction> dfuncs;
+	std::vector<DumpLine> dlines;
+	std::vector<uint64_t> func_counts, line_counts;
+	std::vector<uint8_t> line_flags;
+
+	for (auto &f : files) {
+		SourceFile &sf = f.second;
+
+		DumpFile df;
+		df.name = add_string(sf.name);
+		df.first_func = dfuncs.size();
+		df.nfuncs = sf.funcs.size();
+		df.first_line = dlines.size();
+		df.nlines = sf.lines.size();
+		dfiles.push_back(df);
+
+		for (auto &fn : sf.funcs) {
+			Function &func = fn.second;
+
+			DumpFunction dfn;
+			dfn.name = add_string(func.name);
+			dfn.start_line = func.definition.first.line;
+			dfn.start_column = func.definition.first.column;
+			dfn.end_line = func.definition.second.line;
+			dfn.end_column = func.definition.second.column;
+
+			std::vector<uint64_t> ids;
+			for (auto block : func.blocks)
+				ids.push_back(block_ids.at(block));
+			add_refs(ids, dfn.first_block, dfn.nblocks);
+
+			dfuncs.push_back(dfn);
+			func_counts.push_back(func.exec_count);
+		}
+
+		for (auto &l : sf.lines) {
+			SourceLine &sl = l.second;
+
+			DumpLine dl;
+			dl.func_name = add_string(sl.func_name);
+			dl.line = sl.definition.line;
+			dl.column = sl.definition.column;
+
+			std::vector<uint64_t> ids;
+			for (auto block : sl.blocks)
+				ids.push_back(block_ids.at(block));
+			add_refs(ids, dl.first_block, dl.nblocks);
+
+			ids.clear();
+			for (auto branch : sl.branches)
+				ids.push_back(branch_ids.at(branch));
+			add_refs(ids, dl.first_branch, dl.nbranches);
+
+			dlines.push_back(dl);
+			line_counts.push_back(sl.exec_count);
+			line_flags.push_back((sl.symbolic_once ? DUMP_LINE_SYMBOLIC : 0) |
+				(sl.tainted_once ? DUMP_LINE_TAINTED : 0) |
+				(sl.initial_conc ? DUMP_LINE_INITIAL_CONC : 0));
+		}
+	}
+
+	// Pad the strtab, the structure sections must not have gaps.
+	strtab.resize(ALIGN(strtab.size()), '\0');
+
+	DumpHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, DUMP_MAGIC, sizeof(DUMP_MAGIC));
+	header.version = DUMP_VERSION;
+	header.nfiles = dfiles.size();
+	header.nfuncs = dfuncs.size();
+	header.nlines = dlines.size();
+	header.nblocks = blocks.size();
+	header.nbranches = branches.size();
+	header.nrefs = refs.size();
+	header.strtab_size = strtab.size();
+
+	std::vector<uint8_t> buf(ALIGN(sizeof(header)), 0);
+	header.files = append(buf, dfiles.data(), dfiles.size());
+	header.funcs = append(buf, dfuncs.data(), dfuncs.size());
+	header.lines = append(buf, dlines.data(), dlines.size());
+	header.refs = append(buf, refs.data(), refs.size());
+	header.strtab = append(buf, strtab.data(), strtab.size());
+	header.structure_hash = fnv1a(buf.data() + header.files, buf.size() - header.files);
+
+	header.func_counts = append(buf, func_counts.data(), func_counts.size());
+	header.line_counts = append(buf, line_counts.data(), line_counts.size());
+	header.line_flags = append(buf, line_flags.data(), line_flags.size());
+	header.block_bitmap = append(buf, bitmap.data(), bitmap.size());
+	header.branch_counts = append(buf, branch_counts.data(), branch_counts.size());
+	header.size = buf.size();
+	memcpy(buf.data(), &header, sizeof(header));
+
+	std::ofstream out(fp, std::ios::binary);
+	if (!out.is_open())
+		throw std::runtime_error("failed to open " + fp.string());
+	out.write((char *)buf.data(), buf.size());
+	if (!out)
+		throw std::runtime_error("failed to write " + fp.string());
+}
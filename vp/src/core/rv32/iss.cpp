@@ -57,17 +57,18 @@ using namespace rv32;
 #define RS2 instr.rs2()
 #define RS3 instr.rs3()
 
-#define PC solver.BVC(std::nullopt, (uint32_t)pc)
-#define LAST_PC solver.BVC(std::nullopt, (uint32_t)last_pc)
+// Address dependent values are constant for a decoded instruction,
+// since the decoded instruction cache is physically indexed.
+#define PC imm_operand((uint32_t)pc)
 
-#define I_IMM solver.BVC(std::nullopt, (uint32_t)instr.I_imm())->sext(32)
-#define S_IMM solver.BVC(std::nullopt, (uint32_t)instr.S_imm())->sext(32)
-#define U_IMM solver.BVC(std::nullopt, (uint32_t)instr.U_imm()) /* XXX: sext? */
-#define SHAMT solver.BVC(std::nullopt, (uint32_t)instr.shamt())
+#define I_IMM imm_operand((uint32_t)instr.I_imm())
+#define S_IMM imm_operand((uint32_t)instr.S_imm())
+#define U_IMM imm_operand((uint32_t)instr.U_imm()) /* XXX: sext? */
+#define SHAMT imm_operand((uint32_t)instr.shamt())
 
-#define REG_UINT32_MAX solver.BVC(std::nullopt, (uint32_t)-1)
+#define REG_UINT32_MAX solver.BVConst((uint32_t)-1)
 #define REG_INT32_MIN solver.BVC(std::nullopt, (uint32_t)REG_MIN)
-#define REG_ZERO solver.BVC(std::nullopt, (uint32_t)0)
+#define REG_ZERO solver.BVConst((uint32_t)0)
 
 const char *regnames[] = {
     "zero (x0)", "ra   (x1)", "sp   (x2)", "gp   (x3)", "tp   (x4)", "t0   (x5)", "t1   (x6)", "t2   (x7)",
@@ -90,12 +91,13 @@ int regcolors[] = {
 
 RegFile::RegFile(clover::Solver &_solver, clover::Trace &_trace) : solver(_solver), trace(_trace) {
 	for (size_t i = 0; i < regs.size(); i++)
-		regs[i] = solver.BVC(std::nullopt, (uint32_t)0);
+		regs[i] = solver.BVConst((uint32_t)0);
 }
 
 RegFile::RegFile(clover::Solver &_solver, clover::Trace &_trace, const RegFile &other) : solver(_solver), trace(_trace) {
 	for (size_t i = 0; i < regs.size(); i++)
 		regs[i] = other.regs[i];
+	symbolic_regs = other.symbolic_regs;
 }
 
 void RegFile::write(uint32_t index, RegFile::RegValue value) {
@@ -106,6 +108,12 @@ void RegFile::write(uint32_t index, RegFile::RegValue value) {
 		regs[index] = value;
 	else
 		assert("invalid register width");
+
+	auto &reg = regs[index];
+	if (reg->symbolic.has_value() || reg->is_tainted())
+		symbolic_regs |= 1U << index;
+	else
+		symbolic_regs &= ~(1U << index);
 }
 
 RegFile::RegValue RegFile::read(uint32_t index) {
@@ -119,6 +127,12 @@ RegFile::RegValue RegFile::shamt(uint32_t index) {
 	return regs[index]->extract(0, 5)->zext(32);
 }
 
+void RegFile::taint(uint32_t index) {
+	assert(index <= x31);
+	regs[index]->taint();
+	symbolic_regs |= 1U << index;
+}
+
 const RegFile::RegValue &RegFile::operator[](const uint32_t idx) {
 	return regs[idx];
 }
@@ -181,60 +195,105 @@ ISS::ISS(SymbolicContext &c, uint32_t hart_id, bool use_E_base_isa)
 	op = Opcode::UNDEF;
 }
 
-void ISS::exec_step() {
-	assert(((pc & ~pc_alignment_mask()) == 0) && "misaligned instruction");
+DecodedPage *ISS::get_decoded_page(uint32_t page_num, bool create) {
+	if (last_decoded_page && last_decoded_page_num == page_num)
+		return last_decoded_page;
+
+	auto it = decoded_pages.find(page_num);
+	if (it == decoded_pages.end()) {
+		if (!create)
+			return nullptr;
+		it = decoded_pages.emplace(page_num, std::make_unique<DecodedPage>()).first;
+	}
+
+	last_decoded_page = it->second.get();
+	last_decoded_page_num = page_num;
+	return last_decoded_page;
+}
+
+// Fetches and decodes the instruction at addr. Decoded instructions are
+// cached by physical address, the cache is thus only used if the
+// instruction fetch is not subject to address translation.
+DecodedInstr *ISS::decode_instr(uint32_t addr) {
+	DecodedInstr *entry = &decoded_uncached;
+	if (fetch_is_physical()) {
+		auto page = get_decoded_page(addr >> DecodedPage::SHIFT, true);
+		entry = &page->instrs[(addr & (DecodedPage::SIZE - 1)) >> 1];
+		if (entry->size)
+			return entry;
+	}
 
 	try {
-		uint32_t mem_word = instr_mem->load_instr(pc);
-		instr = Instruction(mem_word);
+		entry->instr = Instruction(instr_mem->load_instr(addr));
 	} catch (SimulationTrap &e) {
 		op = Opcode::UNDEF;
 		instr = Instruction(0);
 		throw;
 	}
 
-	if (instr.is_compressed()) {
-		op = instr.decode_and_expand_compressed(RV32);
-		pc += 2;
-        if (op != Opcode::UNDEF)
-            REQUIRE_ISA(C_ISA_EXT);
-    } else {
-		op = instr.decode_normal(RV32);
-		pc += 4;
+	if (entry->instr.is_compressed()) {
+		entry->op = entry->instr.decode_and_expand_compressed(RV32);
+		entry->size = 2;
+	} else {
+		entry->op = entry->instr.decode_normal(RV32);
+		entry->size = 4;
 	}
 
-	bool initial_concretization = false;
-	bool tainted_operand = false;
-	bool symbolic_operand = false;
-	if (coverage) {
-		std::vector<uint32_t> rops;
-		switch (Opcode::getType(op)) {
-			case Opcode::Type::B:
-			case Opcode::Type::S:
-			case Opcode::Type::R:
-				rops.push_back(instr.rs1());
-				rops.push_back(instr.rs2());
-				break;
-			case Opcode::Type::I:
-				rops.push_back(instr.rs1());
-				break;
-			case Opcode::Type::U:
-			case Opcode::Type::J:
-			case Opcode::Type::UNKNOWN:
-				break; /* no register input operand */
-			case Opcode::Type::R4:
-				throw "Opcode::Type::R4 not supported yet";
-				break;
-		}
+	entry->imm = nullptr;
+	return entry;
+}
 
-		for (auto reg : rops) {
-			auto r = regs[reg];
-			if (r->is_tainted())
-				tainted_operand = true;
-			if (r->symbolic.has_value())
-				symbolic_operand = true;
+// Invalidates decoded instructions overlapping with the given range
+// of physical memory, an instruction may start two bytes earlier.
+void ISS::invalidate_decoded(uint64_t addr, size_t num_bytes) {
+	if (decoded_pages.empty())
+		return;
+
+	uint64_t start = (addr >= 2) ? (addr & ~1ULL) - 2 : 0;
+	for (uint64_t a = start; a < addr + num_bytes; a += 2) {
+		auto page = get_decoded_page(a >> DecodedPage::SHIFT, false);
+		if (!page)
+			continue;
+
+		page->instrs[(a & (DecodedPage::SIZE - 1)) >> 1].size = 0;
+		for (auto it = page->blocks.begin(); it != page->blocks.end();) {
+			auto &block = *it;
+			if (block->start < addr + num_bytes && addr < block->end) {
+				block->valid = false;
+				blocks.erase(block->start);
+				it = page->blocks.erase(it);
+			} else {
+				it++;
+			}
 		}
 	}
+}
+
+void ISS::flush_decoded() {
+	for (auto &block : blocks)
+		block.second->valid = false;
+	blocks.clear();
+
+	decoded_pages.clear();
+	last_decoded_page = nullptr;
+}
+
+std::shared_ptr<clover::ConcolicValue> ISS::imm_operand(uint32_t value) {
+	if (!decoded->imm)
+		decoded->imm = solver.BVC(std::nullopt, value);
+	return decoded->imm;
+}
+
+void ISS::exec_step() {
+	assert(((pc & ~pc_alignment_mask()) == 0) && "misaligned instruction");
+
+	decoded = decode_instr(pc);
+	instr = decoded->instr;
+	op = decoded->op;
+
+	pc += decoded->size;
+	if (decoded->size == 2 && op != Opcode::UNDEF)
+		REQUIRE_ISA(C_ISA_EXT);
 
 	if (trace) {
 		printf("core %2u: prv %1x: pc %8x: %s ", csrs.mhartid.reg, prv, last_pc, Opcode::mappingStr[op]);
@@ -267,6 +326,54 @@ void ISS::exec_step() {
 		puts("");
 	}
 
+	// RV32F opcodes form a contiguous range in Opcode::Mapping, they
+	// are executed on concrete values in both modes (see exec_step_fp).
+	if (op >= Opcode::FLW && op <= Opcode::FMV_W_X) {
+		bool tainted_operand = false;
+		bool initial_concretization = false;
+		exec_step_fp(tainted_operand, initial_concretization);
+		coverage->cover(last_pc, tainted_operand, initial_concretization, initial_concretization);
+		return;
+	}
+
+	if (concrete_mode && exec_step_concrete()) {
+		coverage->cover(last_pc, false, false, false);
+		return;
+	}
+
+	bool initial_concretization = false;
+	bool tainted_operand = false;
+	bool symbolic_operand = false;
+	if (coverage) {
+		std::vector<uint32_t> rops;
+		switch (Opcode::getType(op)) {
+			case Opcode::Type::B:
+			case Opcode::Type::S:
+			case Opcode::Type::R:
+				rops.push_back(instr.rs1());
+				rops.push_back(instr.rs2());
+				break;
+			case Opcode::Type::I:
+				rops.push_back(instr.rs1());
+				break;
+			case Opcode::Type::U:
+			case Opcode::Type::J:
+			case Opcode::Type::UNKNOWN:
+				break; /* no register input operand */
+			case Opcode::Type::R4:
+				throw "Opcode::Type::R4 not supported yet";
+				break;
+		}
+
+		for (auto reg : rops) {
+			auto r = regs[reg];
+			if (r->is_tainted())
+				tainted_operand = true;
+			if (r->symbolic.has_value())
+				symbolic_operand = true;
+		}
+	}
+
 	switch (op) {
 		case Opcode::UNDEF:
 			if (trace)
@@ -356,7 +463,7 @@ void ISS::exec_step() {
 			break;
 
 		case Opcode::AUIPC:
-			regs.write(RD, LAST_PC->add(U_IMM));
+			regs.write(RD, imm_operand(last_pc + instr.U_imm()));
 			break;
 
 		case Opcode::JAL: {
@@ -364,6 +471,7 @@ void ISS::exec_step() {
 			pc = last_pc + instr.J_imm();
 			trap_check_pc_alignment();
 			regs.write(RD, link);
+			coverage->cover_edge(last_pc, pc);
 		} break;
 
 		case Opcode::JALR: {
@@ -374,6 +482,7 @@ void ISS::exec_step() {
 
 			trap_check_pc_alignment();
 			regs.write(RD, link);
+			coverage->cover_edge(last_pc, pc);
 		} break;
 
 		case Opcode::SB: {
@@ -401,7 +510,7 @@ void ISS::exec_step() {
 			regs.write(RD, mem->load_byte(addr));
 
 			if (addr->symbolic.has_value()) {
-				regs[RD]->taint();
+				regs.taint(RD);
 				initial_concretization = true;
 			}
 		} break;
@@ -412,7 +521,7 @@ void ISS::exec_step() {
 			regs.write(RD, mem->load_half(addr));
 
 			if (addr->symbolic.has_value()) {
-				regs[RD]->taint();
+				regs.taint(RD);
 				initial_concretization = true;
 			}
 		} break;
@@ -423,7 +532,7 @@ void ISS::exec_step() {
                 	regs.write(RD, mem->load_word(addr));
 
 			if (addr->symbolic.has_value()) {
-				regs[RD]->taint();
+				regs.taint(RD);
 				initial_concretization = true;
 			}
 		} break;
@@ -433,7 +542,7 @@ void ISS::exec_step() {
 			regs.write(RD, mem->load_ubyte(addr));
 
 			if (addr->symbolic.has_value()) {
-				regs[RD]->taint();
+				regs.taint(RD);
 				initial_concretization = true;
 			}
 		} break;
@@ -444,7 +553,7 @@ void ISS::exec_step() {
 			regs.write(RD, mem->load_uhalf(addr));
 
 			if (addr->symbolic.has_value()) {
-				regs[RD]->taint();
+				regs.taint(RD);
 				initial_concretization = true;
 			}
 		} break;
@@ -458,6 +567,7 @@ void ISS::exec_step() {
 			}
 
 			track_and_trace_branch(cond, res);
+			coverage->cover_branch(last_pc, pc, cond);
 		} break;
 
 		case Opcode::BNE: {
@@ -469,6 +579,7 @@ void ISS::exec_step() {
 			}
 
 			track_and_trace_branch(cond, res);
+			coverage->cover_branch(last_pc, pc, cond);
 		} break;
 
 		case Opcode::BLT: {
@@ -480,6 +591,7 @@ void ISS::exec_step() {
 			}
 
 			track_and_trace_branch(cond, res);
+			coverage->cover_branch(last_pc, pc, cond);
 		} break;
 
 		case Opcode::BGE: {
@@ -491,6 +603,7 @@ void ISS::exec_step() {
 			}
 
 			track_and_trace_branch(cond, res);
+			coverage->cover_branch(last_pc, pc, cond);
 		} break;
 
 		case Opcode::BLTU: {
@@ -502,6 +615,7 @@ void ISS::exec_step() {
 			}
 
 			track_and_trace_branch(cond, res);
+			coverage->cover_branch(last_pc, pc, cond);
 		} break;
 
 		case Opcode::BGEU: {
@@ -513,13 +627,17 @@ void ISS::exec_step() {
 			}
 
 			track_and_trace_branch(cond, res);
+			coverage->cover_branch(last_pc, pc, cond);
 		} break;
 
-		case Opcode::FENCE:
-		case Opcode::FENCE_I: {
+		case Opcode::FENCE: {
 			// not using out of order execution so can be ignored
 		} break;
 
+		case Opcode::FENCE_I:
+			flush_decoded();
+			break;
+
 		case Opcode::ECALL: {
 			if (sys && solver.getValue<uint32_t>(regs[RegFile::a7]->concrete) != 0) {
 				sys->execute_syscall(this);
@@ -639,16 +757,9 @@ void ISS::exec_step() {
 			}
 		} break;
 
-#if 0
 		case Opcode::MUL: {
 			REQUIRE_ISA(M_ISA_EXT);
-
-			auto rs1 = regs[RS1]->sext(64);
-			auto rs2 = regs[RS2]->sext(64);
-			auto ans = rs1->mul(rs2);
-			ans = ans->extract(0,32);
-
-			regs.write(RD, ans);
+			regs.write(RD, regs[RS1]->mul(regs[RS2]));
 		} break;
 
 		case Opcode::MULH: {
@@ -656,10 +767,7 @@ void ISS::exec_step() {
 
 			auto rs1 = regs[RS1]->sext(64);
 			auto rs2 = regs[RS2]->sext(64);
-			auto ans = rs1->mul(rs2);
-			ans = ans->extract(32,32);
-			
-			regs.write(RD, ans);
+			regs.write(RD, rs1->mul(rs2)->extract(32, 32));
 		} break;
 
 		case Opcode::MULHU: {
@@ -667,10 +775,7 @@ void ISS::exec_step() {
 
 			auto rs1 = regs[RS1]->zext(64);
 			auto rs2 = regs[RS2]->zext(64);
-			auto ans = rs1->mul(rs2);
-			ans = ans->extract(32,32);
-
-			regs.write(RD, ans);
+			regs.write(RD, rs1->mul(rs2)->extract(32, 32));
 		} break;
 
 		case Opcode::MULHSU: {
@@ -678,12 +783,15 @@ void ISS::exec_step() {
 
 			auto rs1 = regs[RS1]->sext(64);
 			auto rs2 = regs[RS2]->zext(64);
-			auto ans = rs1->mul(rs2);
-			ans = ans->extract(32,32);
-
-			regs.write(RD, ans);
+			regs.write(RD, rs1->mul(rs2)->extract(32, 32));
 		} break;
 
+		// Division by zero is undefined for KLEE expressions, the
+		// result is thus computed without a division in this case.
+		// If the divisor is symbolic, this requires a branch. The
+		// overflow case (INT32_MIN / -1) of DIV and REM needs no
+		// special handling as the expressions wrap around as well.
+
 		case Opcode::DIV: {
 			REQUIRE_ISA(M_ISA_EXT);
 
@@ -691,18 +799,12 @@ void ISS::exec_step() {
 			auto rs2 = regs[RS2];
 
 			auto expr_zero = rs2->eq(REG_ZERO);
-			auto expr_min = regs[RS1]->eq(REG_INT32_MIN);
-			auto expr_rs2_m = regs[RS2]->eq(REG_UINT32_MAX);
-			auto expr_min_rs2_m = expr_min->band(expr_rs2_m);
-
-			// select can not be used with expressions that may cause div-by-zero
 			bool cond_is_rs2_zero = eval(expr_zero->concrete);
 
 			if (cond_is_rs2_zero) {
 				regs.write(RD, REG_UINT32_MAX);
-			} else{
-				auto ans = expr_min_rs2_m->select(rs1,rs1->sdiv(rs2));
-				regs.write(RD, ans);
+			} else {
+				regs.write(RD, rs1->sdiv(rs2));
 			}
 
 			track_and_trace_branch(cond_is_rs2_zero, expr_zero);
@@ -719,7 +821,7 @@ void ISS::exec_step() {
 
 			if (cond_is_rs2_zero) {
 				regs.write(RD, REG_UINT32_MAX);
-			} else{
+			} else {
 				regs.write(RD, rs1->udiv(rs2));
 			}
 
@@ -733,17 +835,12 @@ void ISS::exec_step() {
 			auto rs2 = regs[RS2];
 
 			auto expr_zero = rs2->eq(REG_ZERO);
-			auto expr_min = rs1->eq(REG_INT32_MIN);
-			auto expr_rs2_m = rs2->eq(REG_UINT32_MAX);
-			auto expr_min_rs2_m = expr_min->band(expr_rs2_m);
-
 			bool cond_is_rs2_zero = eval(expr_zero->concrete);
 
 			if (cond_is_rs2_zero) {
 				regs.write(RD, rs1);
-			} else{
-				auto ans = expr_min_rs2_m->select(REG_ZERO,rs1->srem(rs2));
-				regs.write(RD, ans);
+			} else {
+				regs.write(RD, rs1->srem(rs2));
 			}
 
 			track_and_trace_branch(cond_is_rs2_zero, expr_zero);
@@ -760,13 +857,14 @@ void ISS::exec_step() {
 
 			if (cond_is_rs2_zero) {
 				regs.write(RD, rs1);
-			} else{
+			} else {
 				regs.write(RD, rs1->urem(rs2));
 			}
 
 			track_and_trace_branch(cond_is_rs2_zero, expr_zero);
 		} break;
 
+#if 0
 		case Opcode::LR_W: {
             REQUIRE_ISA(A_ISA_EXT);
 			uint32_t addr = regs[instr.rs1()];
@@ -834,555 +932,912 @@ void ISS::exec_step() {
 			execute_amo(instr, [](int32_t a, int32_t b) { return std::max((uint32_t)a, (uint32_t)b); });
 		} break;
 
-			// RV32F Extension
+			// RV32D Extension
 
-		case Opcode::FLW: {
-            REQUIRE_ISA(F_ISA_EXT);
-			uint32_t addr = regs[instr.rs1()] + instr.I_imm();
-			trap_check_addr_alignment<4, true>(addr);
-			fp_regs.write(RD, float32_t{(uint32_t)mem->load_word(addr)});
-		} break;
+        case Opcode::FLD: {
+            REQUIRE_ISA(D_ISA_EXT);
+            uint32_t addr = regs[instr.rs1()] + instr.I_imm();
+            trap_check_addr_alignment<8, true>(addr);
+            fp_regs.write(RD, float64_t{(uint64_t)mem->load_double(addr)});
+        } break;
 
-		case Opcode::FSW: {
-            REQUIRE_ISA(F_ISA_EXT);
-			uint32_t addr = regs[instr.rs1()] + instr.S_imm();
-			trap_check_addr_alignment<4, false>(addr);
-            mem->store_word(addr, fp_regs.u32(RS2));
-		} break;
+        case Opcode::FSD: {
+            REQUIRE_ISA(D_ISA_EXT);
+            uint32_t addr = regs[instr.rs1()] + instr.S_imm();
+            trap_check_addr_alignment<8, false>(addr);
+            mem->store_double(addr, fp_regs.f64(RS2).v);
+        } break;
 
-		case Opcode::FADD_S: {
-            REQUIRE_ISA(F_ISA_EXT);
-			fp_prepare_instr();
-			fp_setup_rm();
-			fp_regs.write(RD, f32_add(fp_regs.f32(RS1), fp_regs.f32(RS2)));
-			fp_finish_instr();
-		} break;
+        case Opcode::FADD_D: {
+            REQUIRE_ISA(D_ISA_EXT);
+            fp_prepare_instr();
+            fp_setup_rm();
+            fp_regs.write(RD, f64_add(fp_regs.f64(RS1), fp_regs.f64(RS2)));
+            fp_finish_instr();
+        } break;
 
-		case Opcode::FSUB_S: {
-            REQUIRE_ISA(F_ISA_EXT);
-			fp_prepare_instr();
-			fp_setup_rm();
-			fp_regs.write(RD, f32_sub(fp_regs.f32(RS1), fp_regs.f32(RS2)));
-			fp_finish_instr();
-		} break;
+        case Opcode::FSUB_D: {
+            REQUIRE_ISA(D_ISA_EXT);
+            fp_prepare_instr();
+            fp_setup_rm();
+            fp_regs.write(RD, f64_sub(fp_regs.f64(RS1), fp_regs.f64(RS2)));
+            fp_finish_instr();
+        } break;
 
-		case Opcode::FMUL_S: {
-            REQUIRE_ISA(F_ISA_EXT);
-			fp_prepare_instr();
-			fp_setup_rm();
-			fp_regs.write(RD, f32_mul(fp_regs.f32(RS1), fp_regs.f32(RS2)));
-			fp_finish_instr();
-		} break;
+        case Opcode::FMUL_D: {
+            REQUIRE_ISA(D_ISA_EXT);
+            fp_prepare_instr();
+            fp_setup_rm();
+            fp_regs.write(RD, f64_mul(fp_regs.f64(RS1), fp_regs.f64(RS2)));
+            fp_finish_instr();
+        } break;
 
-		case Opcode::FDIV_S: {
-            REQUIRE_ISA(F_ISA_EXT);
-			fp_prepare_instr();
-			fp_setup_rm();
-			fp_regs.write(RD, f32_div(fp_regs.f32(RS1), fp_regs.f32(RS2)));
-			fp_finish_instr();
-		} break;
+        case Opcode::FDIV_D: {
+            REQUIRE_ISA(D_ISA_EXT);
+            fp_prepare_instr();
+            fp_setup_rm();
+            fp_regs.write(RD, f64_div(fp_regs.f64(RS1), fp_regs.f64(RS2)));
+            fp_finish_instr();
+        } break;
 
-		case Opcode::FSQRT_S: {
-            REQUIRE_ISA(F_ISA_EXT);
-			fp_prepare_instr();
-			fp_setup_rm();
-			fp_regs.write(RD, f32_sqrt(fp_regs.f32(RS1)));
-			fp_finish_instr();
-		} break;
+        case Opcode::FSQRT_D: {
+            REQUIRE_ISA(D_ISA_EXT);
+            fp_prepare_instr();
+            fp_setup_rm();
+            fp_regs.write(RD, f64_sqrt(fp_regs.f64(RS1)));
+            fp_finish_instr();
+        } break;
 
-		case Opcode::FMIN_S: {
-            REQUIRE_ISA(F_ISA_EXT);
-			fp_prepare_instr();
+        case Opcode::FMIN_D: {
+            REQUIRE_ISA(D_ISA_EXT);
+            fp_prepare_instr();
 
-			bool rs1_smaller = f32_lt_quiet(fp_regs.f32(RS1), fp_regs.f32(RS2)) ||
-			                   (f32_eq(fp_regs.f32(RS1), fp_regs.f32(RS2)) && f32_isNegative(fp_regs.f32(RS1)));
+            bool rs1_smaller = f64_lt_quiet(fp_regs.f64(RS1), fp_regs.f64(RS2)) ||
+                               (f64_eq(fp_regs.f64(RS1), fp_regs.f64(RS2)) && f64_isNegative(fp_regs.f64(RS1)));
 
-			if (f32_isNaN(fp_regs.f32(RS1)) && f32_isNaN(fp_regs.f32(RS2))) {
-				fp_regs.write(RD, f32_defaultNaN);
-			} else {
-				if (rs1_smaller)
-					fp_regs.write(RD, fp_regs.f32(RS1));
-				else
-					fp_regs.write(RD, fp_regs.f32(RS2));
-			}
+            if (f64_isNaN(fp_regs.f64(RS1)) && f64_isNaN(fp_regs.f64(RS2))) {
+                fp_regs.write(RD, f64_defaultNaN);
+            } else {
+                if (rs1_smaller)
+                    fp_regs.write(RD, fp_regs.f64(RS1));
+                else
+                    fp_regs.write(RD, fp_regs.f64(RS2));
+            }
 
-			fp_finish_instr();
-		} break;
+            fp_finish_instr();
+        } break;
 
-		case Opcode::FMAX_S: {
-            REQUIRE_ISA(F_ISA_EXT);
-			fp_prepare_instr();
+        case Opcode::FMAX_D: {
+            REQUIRE_ISA(D_ISA_EXT);
+            fp_prepare_instr();
 
-			bool rs1_greater = f32_lt_quiet(fp_regs.f32(RS2), fp_regs.f32(RS1)) ||
-			                   (f32_eq(fp_regs.f32(RS2), fp_regs.f32(RS1)) && f32_isNegative(fp_regs.f32(RS2)));
+            bool rs1_greater = f64_lt_quiet(fp_regs.f64(RS2), fp_regs.f64(RS1)) ||
+                               (f64_eq(fp_regs.f64(RS2), fp_regs.f64(RS1)) && f64_isNegative(fp_regs.f64(RS2)));
 
-			if (f32_isNaN(fp_regs.f32(RS1)) && f32_isNaN(fp_regs.f32(RS2))) {
-				fp_regs.write(RD, f32_defaultNaN);
-			} else {
-				if (rs1_greater)
-					fp_regs.write(RD, fp_regs.f32(RS1));
-				else
-					fp_regs.write(RD, fp_regs.f32(RS2));
-			}
+            if (f64_isNaN(fp_regs.f64(RS1)) && f64_isNaN(fp_regs.f64(RS2))) {
+                fp_regs.write(RD, f64_defaultNaN);
+            } else {
+                if (rs1_greater)
+                    fp_regs.write(RD, fp_regs.f64(RS1));
+                else
+                    fp_regs.write(RD, fp_regs.f64(RS2));
+            }
 
-			fp_finish_instr();
-		} break;
+            fp_finish_instr();
+        } break;
 
-		case Opcode::FMADD_S: {
-            REQUIRE_ISA(F_ISA_EXT);
-			fp_prepare_instr();
-			fp_setup_rm();
-			fp_regs.write(RD, f32_mulAdd(fp_regs.f32(RS1), fp_regs.f32(RS2), fp_regs.f32(RS3)));
-			fp_finish_instr();
-		} break;
+        case Opcode::FMADD_D: {
+            REQUIRE_ISA(D_ISA_EXT);
+            fp_prepare_instr();
+            fp_setup_rm();
+            fp_regs.write(RD, f64_mulAdd(fp_regs.f64(RS1), fp_regs.f64(RS2), fp_regs.f64(RS3)));
+            fp_finish_instr();
+        } break;
 
-		case Opcode::FMSUB_S: {
-            REQUIRE_ISA(F_ISA_EXT);
-			fp_prepare_instr();
-			fp_setup_rm();
-			fp_regs.write(RD, f32_mulAdd(fp_regs.f32(RS1), fp_regs.f32(RS2), f32_neg(fp_regs.f32(RS3))));
-			fp_finish_instr();
-		} break;
-
-		case Opcode::FNMADD_S: {
-            REQUIRE_ISA(F_ISA_EXT);
-			fp_prepare_instr();
-			fp_setup_rm();
-			fp_regs.write(RD, f32_mulAdd(f32_neg(fp_regs.f32(RS1)), fp_regs.f32(RS2), f32_neg(fp_regs.f32(RS3))));
-			fp_finish_instr();
-		} break;
-
-		case Opcode::FNMSUB_S: {
-            REQUIRE_ISA(F_ISA_EXT);
-			fp_prepare_instr();
-			fp_setup_rm();
-			fp_regs.write(RD, f32_mulAdd(f32_neg(fp_regs.f32(RS1)), fp_regs.f32(RS2), fp_regs.f32(RS3)));
-			fp_finish_instr();
-		} break;
-
-		case Opcode::FCVT_W_S: {
-            REQUIRE_ISA(F_ISA_EXT);
-			fp_prepare_instr();
-			fp_setup_rm();
-			regs[RD] = f32_to_i32(fp_regs.f32(RS1), softfloat_roundingMode, true);
-			fp_finish_instr();
-		} break;
-
-		case Opcode::FCVT_WU_S: {
-            REQUIRE_ISA(F_ISA_EXT);
-			fp_prepare_instr();
-			fp_setup_rm();
-			regs[RD] = f32_to_ui32(fp_regs.f32(RS1), softfloat_roundingMode, true);
-			fp_finish_instr();
-		} break;
-
-		case Opcode::FCVT_S_W: {
-            REQUIRE_ISA(F_ISA_EXT);
-			fp_prepare_instr();
-			fp_setup_rm();
-			fp_regs.write(RD, i32_to_f32(regs[RS1]));
-			fp_finish_instr();
-		} break;
-
-		case Opcode::FCVT_S_WU: {
-            REQUIRE_ISA(F_ISA_EXT);
-			fp_prepare_instr();
-			fp_setup_rm();
-			fp_regs.write(RD, ui32_to_f32(regs[RS1]));
-			fp_finish_instr();
-		} break;
-
-		case Opcode::FSGNJ_S: {
-            REQUIRE_ISA(F_ISA_EXT);
-			fp_prepare_instr();
-			auto f1 = fp_regs.f32(RS1);
-			auto f2 = fp_regs.f32(RS2);
-			fp_regs.write(RD, float32_t{(f1.v & ~F32_SIGN_BIT) | (f2.v & F32_SIGN_BIT)});
-			fp_set_dirty();
-		} break;
-
-		case Opcode::FSGNJN_S: {
-            REQUIRE_ISA(F_ISA_EXT);
-			fp_prepare_instr();
-			auto f1 = fp_regs.f32(RS1);
-			auto f2 = fp_regs.f32(RS2);
-			fp_regs.write(RD, float32_t{(f1.v & ~F32_SIGN_BIT) | (~f2.v & F32_SIGN_BIT)});
-			fp_set_dirty();
-		} break;
-
-		case Opcode::FSGNJX_S: {
-            REQUIRE_ISA(F_ISA_EXT);
-			fp_prepare_instr();
-			auto f1 = fp_regs.f32(RS1);
-			auto f2 = fp_regs.f32(RS2);
-			fp_regs.write(RD, float32_t{f1.v ^ (f2.v & F32_SIGN_BIT)});
-			fp_set_dirty();
-		} break;
-
-		case Opcode::FMV_W_X: {
-            REQUIRE_ISA(F_ISA_EXT);
-			fp_prepare_instr();
-			fp_regs.write(RD, float32_t{(uint32_t)regs[RS1]});
-			fp_set_dirty();
-		} break;
-
-		case Opcode::FMV_X_W: {
-            REQUIRE_ISA(F_ISA_EXT);
-			fp_prepare_instr();
-			regs[RD] = fp_regs.u32(RS1);
-		} break;
-
-		case Opcode::FEQ_S: {
-            REQUIRE_ISA(F_ISA_EXT);
-			fp_prepare_instr();
-			regs[RD] = f32_eq(fp_regs.f32(RS1), fp_regs.f32(RS2));
-			fp_update_exception_flags();
-		} break;
-
-		case Opcode::FLT_S: {
-            REQUIRE_ISA(F_ISA_EXT);
-			fp_prepare_instr();
-			regs[RD] = f32_lt(fp_regs.f32(RS1), fp_regs.f32(RS2));
-			fp_update_exception_flags();
-		} break;
-
-		case Opcode::FLE_S: {
-            REQUIRE_ISA(F_ISA_EXT);
-			fp_prepare_instr();
-			regs[RD] = f32_le(fp_regs.f32(RS1), fp_regs.f32(RS2));
-			fp_update_exception_flags();
-		} break;
-
-		case Opcode::FCLASS_S: {
-            REQUIRE_ISA(F_ISA_EXT);
-			fp_prepare_instr();
-			regs[RD] = f32_classify(fp_regs.f32(RS1));
-		} break;
-
-			// RV32D Extension
-
-        case Opcode::FLD: {
+        case Opcode::FMSUB_D: {
             REQUIRE_ISA(D_ISA_EXT);
-            uint32_t addr = regs[instr.rs1()] + instr.I_imm();
-            trap_check_addr_alignment<8, true>(addr);
-            fp_regs.write(RD, float64_t{(uint64_t)mem->load_double(addr)});
+            fp_prepare_instr();
+            fp_setup_rm();
+            fp_regs.write(RD, f64_mulAdd(fp_regs.f64(RS1), fp_regs.f64(RS2), f64_neg(fp_regs.f64(RS3))));
+            fp_finish_instr();
         } break;
 
-        case Opcode::FSD: {
+        case Opcode::FNMADD_D: {
             REQUIRE_ISA(D_ISA_EXT);
-            uint32_t addr = regs[instr.rs1()] + instr.S_imm();
-            trap_check_addr_alignment<8, false>(addr);
-            mem->store_double(addr, fp_regs.f64(RS2).v);
+            fp_prepare_instr();
+            fp_setup_rm();
+            fp_regs.write(RD, f64_mulAdd(f64_neg(fp_regs.f64(RS1)), fp_regs.f64(RS2), f64_neg(fp_regs.f64(RS3))));
+            fp_finish_instr();
         } break;
 
-        case Opcode::FADD_D: {
+        case Opcode::FNMSUB_D: {
             REQUIRE_ISA(D_ISA_EXT);
             fp_prepare_instr();
             fp_setup_rm();
-            fp_regs.write(RD, f64_add(fp_regs.f64(RS1), fp_regs.f64(RS2)));
+            fp_regs.write(RD, f64_mulAdd(f64_neg(fp_regs.f64(RS1)), fp_regs.f64(RS2), fp_regs.f64(RS3)));
             fp_finish_instr();
         } break;
 
-        case Opcode::FSUB_D: {
+        case Opcode::FSGNJ_D: {
             REQUIRE_ISA(D_ISA_EXT);
             fp_prepare_instr();
-            fp_setup_rm();
-            fp_regs.write(RD, f64_sub(fp_regs.f64(RS1), fp_regs.f64(RS2)));
-            fp_finish_instr();
+            auto f1 = fp_regs.f64(RS1);
+            auto f2 = fp_regs.f64(RS2);
+            fp_regs.write(RD, float64_t{(f1.v & ~F64_SIGN_BIT) | (f2.v & F64_SIGN_BIT)});
+            fp_set_dirty();
         } break;
 
-        case Opcode::FMUL_D: {
+        case Opcode::FSGNJN_D: {
             REQUIRE_ISA(D_ISA_EXT);
             fp_prepare_instr();
-            fp_setup_rm();
-            fp_regs.write(RD, f64_mul(fp_regs.f64(RS1), fp_regs.f64(RS2)));
-            fp_finish_instr();
+            auto f1 = fp_regs.f64(RS1);
+            auto f2 = fp_regs.f64(RS2);
+            fp_regs.write(RD, float64_t{(f1.v & ~F64_SIGN_BIT) | (~f2.v & F64_SIGN_BIT)});
+            fp_set_dirty();
         } break;
 
-        case Opcode::FDIV_D: {
+        case Opcode::FSGNJX_D: {
             REQUIRE_ISA(D_ISA_EXT);
             fp_prepare_instr();
-            fp_setup_rm();
-            fp_regs.write(RD, f64_div(fp_regs.f64(RS1), fp_regs.f64(RS2)));
-            fp_finish_instr();
+            auto f1 = fp_regs.f64(RS1);
+            auto f2 = fp_regs.f64(RS2);
+            fp_regs.write(RD, float64_t{f1.v ^ (f2.v & F64_SIGN_BIT)});
+            fp_set_dirty();
         } break;
 
-        case Opcode::FSQRT_D: {
+        case Opcode::FCVT_S_D: {
             REQUIRE_ISA(D_ISA_EXT);
             fp_prepare_instr();
             fp_setup_rm();
-            fp_regs.write(RD, f64_sqrt(fp_regs.f64(RS1)));
+            fp_regs.write(RD, f64_to_f32(fp_regs.f64(RS1)));
             fp_finish_instr();
         } break;
 
-        case Opcode::FMIN_D: {
+        case Opcode::FCVT_D_S: {
             REQUIRE_ISA(D_ISA_EXT);
             fp_prepare_instr();
-
-            bool rs1_smaller = f64_lt_quiet(fp_regs.f64(RS1), fp_regs.f64(RS2)) ||
-                               (f64_eq(fp_regs.f64(RS1), fp_regs.f64(RS2)) && f64_isNegative(fp_regs.f64(RS1)));
-
-            if (f64_isNaN(fp_regs.f64(RS1)) && f64_isNaN(fp_regs.f64(RS2))) {
-                fp_regs.write(RD, f64_defaultNaN);
-            } else {
-                if (rs1_smaller)
-                    fp_regs.write(RD, fp_regs.f64(RS1));
-                else
-                    fp_regs.write(RD, fp_regs.f64(RS2));
-            }
-
+            fp_setup_rm();
+            fp_regs.write(RD, f32_to_f64(fp_regs.f32(RS1)));
             fp_finish_instr();
         } break;
 
-        case Opcode::FMAX_D: {
+        case Opcode::FEQ_D: {
             REQUIRE_ISA(D_ISA_EXT);
             fp_prepare_instr();
-
-            bool rs1_greater = f64_lt_quiet(fp_regs.f64(RS2), fp_regs.f64(RS1)) ||
-                               (f64_eq(fp_regs.f64(RS2), fp_regs.f64(RS1)) && f64_isNegative(fp_regs.f64(RS2)));
-
-            if (f64_isNaN(fp_regs.f64(RS1)) && f64_isNaN(fp_regs.f64(RS2))) {
-                fp_regs.write(RD, f64_defaultNaN);
-            } else {
-                if (rs1_greater)
-                    fp_regs.write(RD, fp_regs.f64(RS1));
-                else
-                    fp_regs.write(RD, fp_regs.f64(RS2));
-            }
-
-            fp_finish_instr();
+            regs[RD] = f64_eq(fp_regs.f64(RS1), fp_regs.f64(RS2));
+            fp_update_exception_flags();
         } break;
 
-        case Opcode::FMADD_D: {
+        case Opcode::FLT_D: {
             REQUIRE_ISA(D_ISA_EXT);
             fp_prepare_instr();
-            fp_setup_rm();
-            fp_regs.write(RD, f64_mulAdd(fp_regs.f64(RS1), fp_regs.f64(RS2), fp_regs.f64(RS3)));
-            fp_finish_instr();
+            regs[RD] = f64_lt(fp_regs.f64(RS1), fp_regs.f64(RS2));
+            fp_update_exception_flags();
         } break;
 
-        case Opcode::FMSUB_D: {
+        case Opcode::FLE_D: {
             REQUIRE_ISA(D_ISA_EXT);
             fp_prepare_instr();
-            fp_setup_rm();
-            fp_regs.write(RD, f64_mulAdd(fp_regs.f64(RS1), fp_regs.f64(RS2), f64_neg(fp_regs.f64(RS3))));
-            fp_finish_instr();
+            regs[RD] = f64_le(fp_regs.f64(RS1), fp_regs.f64(RS2));
+            fp_update_exception_flags();
         } break;
 
-        case Opcode::FNMADD_D: {
+        case Opcode::FCLASS_D: {
             REQUIRE_ISA(D_ISA_EXT);
             fp_prepare_instr();
-            fp_setup_rm();
-            fp_regs.write(RD, f64_mulAdd(f64_neg(fp_regs.f64(RS1)), fp_regs.f64(RS2), f64_neg(fp_regs.f64(RS3))));
-            fp_finish_instr();
+            regs[RD] = (int64_t)f64_classify(fp_regs.f64(RS1));
         } break;
 
-        case Opcode::FNMSUB_D: {
+        case Opcode::FCVT_W_D: {
             REQUIRE_ISA(D_ISA_EXT);
             fp_prepare_instr();
             fp_setup_rm();
-            fp_regs.write(RD, f64_mulAdd(f64_neg(fp_regs.f64(RS1)), fp_regs.f64(RS2), fp_regs.f64(RS3)));
+            regs[RD] = f64_to_i32(fp_regs.f64(RS1), softfloat_roundingMode, true);
             fp_finish_instr();
         } break;
 
-        case Opcode::FSGNJ_D: {
+        case Opcode::FCVT_WU_D: {
             REQUIRE_ISA(D_ISA_EXT);
             fp_prepare_instr();
-            auto f1 = fp_regs.f64(RS1);
-            auto f2 = fp_regs.f64(RS2);
-            fp_regs.write(RD, float64_t{(f1.v & ~F64_SIGN_BIT) | (f2.v & F64_SIGN_BIT)});
-            fp_set_dirty();
+            fp_setup_rm();
+            regs[RD] = (int32_t)f64_to_ui32(fp_regs.f64(RS1), softfloat_roundingMode, true);
+            fp_finish_instr();
         } break;
 
-        case Opcode::FSGNJN_D: {
+        case Opcode::FCVT_D_W: {
             REQUIRE_ISA(D_ISA_EXT);
             fp_prepare_instr();
-            auto f1 = fp_regs.f64(RS1);
-            auto f2 = fp_regs.f64(RS2);
-            fp_regs.write(RD, float64_t{(f1.v & ~F64_SIGN_BIT) | (~f2.v & F64_SIGN_BIT)});
-            fp_set_dirty();
+            fp_setup_rm();
+            fp_regs.write(RD, i32_to_f64((int32_t)regs[RS1]));
+            fp_finish_instr();
         } break;
 
-        case Opcode::FSGNJX_D: {
+        case Opcode::FCVT_D_WU: {
             REQUIRE_ISA(D_ISA_EXT);
             fp_prepare_instr();
-            auto f1 = fp_regs.f64(RS1);
-            auto f2 = fp_regs.f64(RS2);
-            fp_regs.write(RD, float64_t{f1.v ^ (f2.v & F64_SIGN_BIT)});
-            fp_set_dirty();
+            fp_setup_rm();
+            fp_regs.write(RD, ui32_to_f64((int32_t)regs[RS1]));
+            fp_finish_instr();
         } break;
 
-        case Opcode::FCVT_S_D: {
-            REQUIRE_ISA(D_ISA_EXT);
-            fp_prepare_instr();
-            fp_setup_rm();
-            fp_regs.write(RD, f64_to_f32(fp_regs.f64(RS1)));
-            fp_finish_instr();
-        } break;
+        // privileged instructions
+
+#endif
+        case Opcode::WFI:
+            // NOTE: only a hint, can be implemented as NOP
+            // std::cout << "[sim:wfi] CSR mstatus.mie " << csrs.mstatus->mie << std::endl;
+            release_lr_sc_reservation();
+
+            if (s_mode() && csrs.mstatus.tw)
+                raise_trap(EXC_ILLEGAL_INSTR, instr.data());
+
+            if (u_mode() && csrs.misa.has_supervisor_mode_extension())
+                raise_trap(EXC_ILLEGAL_INSTR, instr.data());
+
+            if (!ignore_wfi && !has_local_pending_enabled_interrupts())
+                sc_core::wait(wfi_event);
+            break;
+
+#if 0
+        case Opcode::SFENCE_VMA:
+            if (s_mode() && csrs.mstatus.tvm)
+                raise_trap(EXC_ILLEGAL_INSTR, instr.data());
+            mem->flush_tlb();
+            break;
+
+        case Opcode::URET:
+            if (!csrs.misa.has_user_mode_extension())
+                raise_trap(EXC_ILLEGAL_INSTR, instr.data());
+            return_from_trap_handler(UserMode);
+            break;
+
+        case Opcode::SRET:
+            if (!csrs.misa.has_supervisor_mode_extension() || (s_mode() && csrs.mstatus.tsr))
+                raise_trap(EXC_ILLEGAL_INSTR, instr.data());
+            return_from_trap_handler(SupervisorMode);
+            break;
+#endif
+
+        case Opcode::MRET:
+            return_from_trap_handler(MachineMode);
+            break;
+
+#if 0
+            // instructions accepted by decoder but not by this RV32IMACF ISS -> do normal trap
+            // RV64I
+        case Opcode::LWU:
+        case Opcode::LD:
+        case Opcode::SD:
+        case Opcode::ADDIW:
+        case Opcode::SLLIW:
+        case Opcode::SRLIW:
+        case Opcode::SRAIW:
+        case Opcode::ADDW:
+        case Opcode::SUBW:
+        case Opcode::SLLW:
+        case Opcode::SRLW:
+        case Opcode::SRAW:
+            // RV64M
+        case Opcode::MULW:
+        case Opcode::DIVW:
+        case Opcode::DIVUW:
+        case Opcode::REMW:
+        case Opcode::REMUW:
+            // RV64A
+        case Opcode::LR_D:
+        case Opcode::SC_D:
+        case Opcode::AMOSWAP_D:
+        case Opcode::AMOADD_D:
+        case Opcode::AMOXOR_D:
+        case Opcode::AMOAND_D:
+        case Opcode::AMOOR_D:
+        case Opcode::AMOMIN_D:
+        case Opcode::AMOMAX_D:
+        case Opcode::AMOMINU_D:
+        case Opcode::AMOMAXU_D:
+            // RV64F
+        case Opcode::FCVT_L_S:
+        case Opcode::FCVT_LU_S:
+        case Opcode::FCVT_S_L:
+        case Opcode::FCVT_S_LU:
+            // RV64D
+        case Opcode::FCVT_L_D:
+        case Opcode::FCVT_LU_D:
+        case Opcode::FMV_X_D:
+        case Opcode::FCVT_D_L:
+        case Opcode::FCVT_D_LU:
+        case Opcode::FMV_D_X:
+            RAISE_ILLEGAL_INSTRUCTION();
+            break;
+
+#endif
+        default:
+            throw std::runtime_error("unknown opcode");
+	}
+
+	coverage->cover(last_pc, tainted_operand, symbolic_operand, initial_concretization);
+}
+
+void ISS::branch_concrete(bool cond) {
+	if (cond) {
+		pc = last_pc + instr.B_imm();
+		trap_check_pc_alignment();
+	}
+
+	coverage->cover_branch(last_pc, pc, cond);
+}
+
+void ISS::switch_to_concrete() {
+	assert(regs.is_concrete());
+
+	for (size_t i = 0; i < cregs.size(); i++)
+		cregs[i] = solver.getValue<uint32_t>(regs[i]->concrete);
+
+	cregs_dirty = 0;
+	concrete_mode = true;
+}
+
+void ISS::switch_to_concolic() {
+	sync_registers();
+	concrete_mode = false;
+}
+
+// Transfers registers modified by the concrete engine to the concolic
+// register file. Only needs to be invoked while in concrete mode.
+void ISS::sync_registers() {
+	if (!concrete_mode)
+		return;
+
+	for (uint32_t i = 0; cregs_dirty; i++) {
+		if (cregs_dirty & (1U << i)) {
+			regs.write(i, solver.BVC(std::nullopt, cregs[i]));
+			cregs_dirty &= ~(1U << i);
+		}
+	}
+}
+
+void ISS::load_concrete(uint32_t index, std::shared_ptr<clover::ConcolicValue> value) {
+	// Loaded value depends on symbolic input, continue in concolic
+	// mode until it is no longer referenced by any register.
+	if (value->symbolic.has_value() || value->is_tainted()) {
+		switch_to_concolic();
+		regs.write(index, value);
+		return;
+	}
+
+	write_concrete(index, solver.getValue<uint32_t>(value->concrete));
+}
+
+// Executes the current instruction on the concrete register file.
+// Returns false, after switching to concolic mode, if the instruction
+// is not supported by the concrete engine. Memory is still accessed
+// through the concolic memory interface, loads of values with a
+// symbolic part switch to concolic mode as well (see load_concrete).
+bool ISS::exec_step_concrete() {
+	switch (op) {
+		case Opcode::ADDI:
+			write_concrete(RD, cregs[RS1] + instr.I_imm());
+			break;
+
+		case Opcode::SLTI:
+			write_concrete(RD, (int32_t)cregs[RS1] < instr.I_imm());
+			break;
+
+		case Opcode::SLTIU:
+			write_concrete(RD, cregs[RS1] < (uint32_t)instr.I_imm());
+			break;
+
+		case Opcode::XORI:
+			write_concrete(RD, cregs[RS1] ^ instr.I_imm());
+			break;
+
+		case Opcode::ORI:
+			write_concrete(RD, cregs[RS1] | instr.I_imm());
+			break;
+
+		case Opcode::ANDI:
+			write_concrete(RD, cregs[RS1] & instr.I_imm());
+			break;
+
+		case Opcode::ADD:
+			write_concrete(RD, cregs[RS1] + cregs[RS2]);
+			break;
+
+		case Opcode::SUB:
+			write_concrete(RD, cregs[RS1] - cregs[RS2]);
+			break;
+
+		case Opcode::SLL:
+			write_concrete(RD, cregs[RS1] << (cregs[RS2] & 0x1f));
+			break;
+
+		case Opcode::SLT:
+			write_concrete(RD, (int32_t)cregs[RS1] < (int32_t)cregs[RS2]);
+			break;
+
+		case Opcode::SLTU:
+			write_concrete(RD, cregs[RS1] < cregs[RS2]);
+			break;
+
+		case Opcode::SRL:
+			write_concrete(RD, cregs[RS1] >> (cregs[RS2] & 0x1f));
+			break;
+
+		case Opcode::SRA:
+			write_concrete(RD, (int32_t)cregs[RS1] >> (cregs[RS2] & 0x1f));
+			break;
+
+		case Opcode::XOR:
+			write_concrete(RD, cregs[RS1] ^ cregs[RS2]);
+			break;
+
+		case Opcode::OR:
+			write_concrete(RD, cregs[RS1] | cregs[RS2]);
+			break;
+
+		case Opcode::AND:
+			write_concrete(RD, cregs[RS1] & cregs[RS2]);
+			break;
+
+		case Opcode::SLLI:
+			write_concrete(RD, cregs[RS1] << instr.shamt());
+			break;
+
+		case Opcode::SRLI:
+			write_concrete(RD, cregs[RS1] >> instr.shamt());
+			break;
+
+		case Opcode::SRAI:
+			write_concrete(RD, (int32_t)cregs[RS1] >> instr.shamt());
+			break;
+
+		case Opcode::LUI:
+			write_concrete(RD, instr.U_imm());
+			break;
+
+		case Opcode::AUIPC:
+			write_concrete(RD, last_pc + instr.U_imm());
+			break;
+
+		case Opcode::JAL: {
+			auto link = pc;
+			pc = last_pc + instr.J_imm();
+			trap_check_pc_alignment();
+			write_concrete(RD, link);
+			coverage->cover_edge(last_pc, pc);
+		} break;
+
+		case Opcode::JALR: {
+			auto link = pc;
+			pc = (cregs[RS1] + instr.I_imm()) & ~1;
+			trap_check_pc_alignment();
+			write_concrete(RD, link);
+			coverage->cover_edge(last_pc, pc);
+		} break;
+
+		case Opcode::SB: {
+			uint32_t addr = cregs[RS1] + instr.S_imm();
+			mem->store_byte(solver.BVC(std::nullopt, addr), solver.BVC(std::nullopt, cregs[RS2]));
+		} break;
+
+		case Opcode::SH: {
+			uint32_t addr = cregs[RS1] + instr.S_imm();
+			trap_check_addr_alignment<2, false>(addr);
+			mem->store_half(solver.BVC(std::nullopt, addr), solver.BVC(std::nullopt, cregs[RS2]));
+		} break;
+
+		case Opcode::SW: {
+			uint32_t addr = cregs[RS1] + instr.S_imm();
+			trap_check_addr_alignment<4, false>(addr);
+			mem->store_word(solver.BVC(std::nullopt, addr), solver.BVC(std::nullopt, cregs[RS2]));
+		} break;
+
+		case Opcode::LB: {
+			uint32_t addr = cregs[RS1] + instr.I_imm();
+			load_concrete(RD, mem->load_byte(solver.BVC(std::nullopt, addr)));
+		} break;
+
+		case Opcode::LH: {
+			uint32_t addr = cregs[RS1] + instr.I_imm();
+			trap_check_addr_alignment<2, true>(addr);
+			load_concrete(RD, mem->load_half(solver.BVC(std::nullopt, addr)));
+		} break;
+
+		case Opcode::LW: {
+			uint32_t addr = cregs[RS1] + instr.I_imm();
+			trap_check_addr_alignment<4, true>(addr);
+			load_concrete(RD, mem->load_word(solver.BVC(std::nullopt, addr)));
+		} break;
+
+		case Opcode::LBU: {
+			uint32_t addr = cregs[RS1] + instr.I_imm();
+			load_concrete(RD, mem->load_ubyte(solver.BVC(std::nullopt, addr)));
+		} break;
+
+		case Opcode::LHU: {
+			uint32_t addr = cregs[RS1] + instr.I_imm();
+			trap_check_addr_alignment<2, true>(addr);
+			load_concrete(RD, mem->load_uhalf(solver.BVC(std::nullopt, addr)));
+		} break;
+
+		case Opcode::MUL:
+			REQUIRE_ISA(M_ISA_EXT);
+			write_concrete(RD, cregs[RS1] * cregs[RS2]);
+			break;
+
+		case Opcode::MULH:
+			REQUIRE_ISA(M_ISA_EXT);
+			write_concrete(RD, ((int64_t)(int32_t)cregs[RS1] * (int64_t)(int32_t)cregs[RS2]) >> 32);
+			break;
+
+		case Opcode::MULHU:
+			REQUIRE_ISA(M_ISA_EXT);
+			write_concrete(RD, ((uint64_t)cregs[RS1] * (uint64_t)cregs[RS2]) >> 32);
+			break;
+
+		case Opcode::MULHSU:
+			REQUIRE_ISA(M_ISA_EXT);
+			write_concrete(RD, ((int64_t)(int32_t)cregs[RS1] * (int64_t)cregs[RS2]) >> 32);
+			break;
+
+		case Opcode::DIV: {
+			REQUIRE_ISA(M_ISA_EXT);
+			int32_t a = cregs[RS1], b = cregs[RS2];
+			if (b == 0)
+				write_concrete(RD, UINT32_MAX);
+			else if (a == REG_MIN && b == -1)
+				write_concrete(RD, a);
+			else
+				write_concrete(RD, a / b);
+		} break;
+
+		case Opcode::DIVU:
+			REQUIRE_ISA(M_ISA_EXT);
+			if (cregs[RS2] == 0)
+				write_concrete(RD, UINT32_MAX);
+			else
+				write_concrete(RD, cregs[RS1] / cregs[RS2]);
+			break;
+
+		case Opcode::REM: {
+			REQUIRE_ISA(M_ISA_EXT);
+			int32_t a = cregs[RS1], b = cregs[RS2];
+			if (b == 0)
+				write_concrete(RD, a);
+			else if (a == REG_MIN && b == -1)
+				write_concrete(RD, 0);
+			else
+				write_concrete(RD, a % b);
+		} break;
+
+		case Opcode::REMU:
+			REQUIRE_ISA(M_ISA_EXT);
+			if (cregs[RS2] == 0)
+				write_concrete(RD, cregs[RS1]);
+			else
+				write_concrete(RD, cregs[RS1] % cregs[RS2]);
+			break;
+
+		case Opcode::BEQ:
+			branch_concrete(cregs[RS1] == cregs[RS2]);
+			break;
+
+		case Opcode::BNE:
+			branch_concrete(cregs[RS1] != cregs[RS2]);
+			break;
+
+		case Opcode::BLT:
+			branch_concrete((int32_t)cregs[RS1] < (int32_t)cregs[RS2]);
+			break;
+
+		case Opcode::BGE:
+			branch_concrete((int32_t)cregs[RS1] >= (int32_t)cregs[RS2]);
+			break;
+
+		case Opcode::BLTU:
+			branch_concrete(cregs[RS1] < cregs[RS2]);
+			break;
+
+		case Opcode::BGEU:
+			branch_concrete(cregs[RS1] >= cregs[RS2]);
+			break;
+
+		case Opcode::FENCE: {
+			// not using out of order execution so can be ignored
+		} break;
+
+		case Opcode::FENCE_I:
+			flush_decoded();
+			break;
+
+		default:
+			// System instructions (CSR access, ECALL, ...) are rare,
+			// execute them on the concolic register file instead.
+			switch_to_concolic();
+			return false;
+	}
+
+	return true;
+}
+
+// Executes an RV32F instruction using SoftFloat. Floating-point
+// operations are only supported on concrete values. Symbolic values
+// reaching a floating-point register are concretized to their current
+// concrete value. Values derived from a concretized value are tainted,
+// fp_tainted tracks this for the floating-point registers.
+void ISS::exec_step_fp(bool &tainted_operand, bool &initial_concretization) {
+	auto int_reg = [this](unsigned idx) {
+		return (concrete_mode) ? solver.BVC(std::nullopt, cregs[idx]) : regs[idx];
+	};
+	auto concretize = [&](std::shared_ptr<clover::ConcolicValue> value) {
+		if (value->symbolic.has_value())
+			initial_concretization = true;
+		if (value->is_tainted())
+			tainted_operand = true;
+		return solver.getValue<uint32_t>(value->concrete);
+	};
+	auto f32 = [&](unsigned idx) {
+		if (fp_tainted & (1U << idx))
+			tainted_operand = true;
+		return fp_regs.f32(idx);
+	};
+	auto tainted_value = [&](uint32_t value) {
+		auto v = solver.BVC(std::nullopt, value);
+		if (tainted_operand || initial_concretization)
+			v->taint();
+		return v;
+	};
+
+	auto write_fp = [&](float32_t value) {
+		fp_regs.write(RD, value);
+		if (tainted_operand || initial_concretization)
+			fp_tainted |= 1U << RD;
+		else
+			fp_tainted &= ~(1U << RD);
+	};
+	auto write_int = [&](uint32_t value) {
+		if (concrete_mode)
+			load_concrete(RD, tainted_value(value));
+		else
+			regs.write(RD, tainted_value(value));
+	};
+
+	switch (op) {
+		case Opcode::FLW: {
+			REQUIRE_ISA(F_ISA_EXT);
+			auto addr = int_reg(RS1)->add(I_IMM);
+			trap_check_addr_alignment<4, true>(addr);
+			auto value = mem->load_word(addr);
+			concretize(addr);
+			write_fp(float32_t{concretize(value)});
+		} break;
+
+		case Opcode::FSW: {
+			REQUIRE_ISA(F_ISA_EXT);
+			auto addr = int_reg(RS1)->add(S_IMM);
+			trap_check_addr_alignment<4, false>(addr);
+			if (fp_tainted & (1U << RS2))
+				tainted_operand = true;
+			mem->store_word(addr, tainted_value(fp_regs.u32(RS2)));
+			concretize(addr);
+		} break;
+
+		case Opcode::FADD_S: {
+			REQUIRE_ISA(F_ISA_EXT);
+			fp_prepare_instr();
+			fp_setup_rm();
+			write_fp(f32_add(f32(RS1), f32(RS2)));
+			fp_finish_instr();
+		} break;
+
+		case Opcode::FSUB_S: {
+			REQUIRE_ISA(F_ISA_EXT);
+			fp_prepare_instr();
+			fp_setup_rm();
+			write_fp(f32_sub(f32(RS1), f32(RS2)));
+			fp_finish_instr();
+		} break;
+
+		case Opcode::FMUL_S: {
+			REQUIRE_ISA(F_ISA_EXT);
+			fp_prepare_instr();
+			fp_setup_rm();
+			write_fp(f32_mul(f32(RS1), f32(RS2)));
+			fp_finish_instr();
+		} break;
+
+		case Opcode::FDIV_S: {
+			REQUIRE_ISA(F_ISA_EXT);
+			fp_prepare_instr();
+			fp_setup_rm();
+			write_fp(f32_div(f32(RS1), f32(RS2)));
+			fp_finish_instr();
+		} break;
+
+		case Opcode::FSQRT_S: {
+			REQUIRE_ISA(F_ISA_EXT);
+			fp_prepare_instr();
+			fp_setup_rm();
+			write_fp(f32_sqrt(f32(RS1)));
+			fp_finish_instr();
+		} break;
+
+		case Opcode::FMIN_S: {
+			REQUIRE_ISA(F_ISA_EXT);
+			fp_prepare_instr();
+
+			auto f1 = f32(RS1);
+			auto f2 = f32(RS2);
+			bool rs1_smaller = f32_lt_quiet(f1, f2) || (f32_eq(f1, f2) && f32_isNegative(f1));
+
+			if (f32_isNaN(f1) && f32_isNaN(f2)) {
+				write_fp(f32_defaultNaN);
+			} else {
+				if (rs1_smaller)
+					write_fp(f1);
+				else
+					write_fp(f2);
+			}
+
+			fp_finish_instr();
+		} break;
+
+		case Opcode::FMAX_S: {
+			REQUIRE_ISA(F_ISA_EXT);
+			fp_prepare_instr();
 
-        case Opcode::FCVT_D_S: {
-            REQUIRE_ISA(D_ISA_EXT);
-            fp_prepare_instr();
-            fp_setup_rm();
-            fp_regs.write(RD, f32_to_f64(fp_regs.f32(RS1)));
-            fp_finish_instr();
-        } break;
+			auto f1 = f32(RS1);
+			auto f2 = f32(RS2);
+			bool rs1_greater = f32_lt_quiet(f2, f1) || (f32_eq(f2, f1) && f32_isNegative(f2));
 
-        case Opcode::FEQ_D: {
-            REQUIRE_ISA(D_ISA_EXT);
-            fp_prepare_instr();
-            regs[RD] = f64_eq(fp_regs.f64(RS1), fp_regs.f64(RS2));
-            fp_update_exception_flags();
-        } break;
+			if (f32_isNaN(f1) && f32_isNaN(f2)) {
+				write_fp(f32_defaultNaN);
+			} else {
+				if (rs1_greater)
+					write_fp(f1);
+				else
+					write_fp(f2);
+			}
 
-        case Opcode::FLT_D: {
-            REQUIRE_ISA(D_ISA_EXT);
-            fp_prepare_instr();
-            regs[RD] = f64_lt(fp_regs.f64(RS1), fp_regs.f64(RS2));
-            fp_update_exception_flags();
-        } break;
+			fp_finish_instr();
+		} break;
 
-        case Opcode::FLE_D: {
-            REQUIRE_ISA(D_ISA_EXT);
-            fp_prepare_instr();
-            regs[RD] = f64_le(fp_regs.f64(RS1), fp_regs.f64(RS2));
-            fp_update_exception_flags();
-        } break;
+		case Opcode::FMADD_S: {
+			REQUIRE_ISA(F_ISA_EXT);
+			fp_prepare_instr();
+			fp_setup_rm();
+			write_fp(f32_mulAdd(f32(RS1), f32(RS2), f32(RS3)));
+			fp_finish_instr();
+		} break;
 
-        case Opcode::FCLASS_D: {
-            REQUIRE_ISA(D_ISA_EXT);
-            fp_prepare_instr();
-            regs[RD] = (int64_t)f64_classify(fp_regs.f64(RS1));
-        } break;
+		case Opcode::FMSUB_S: {
+			REQUIRE_ISA(F_ISA_EXT);
+			fp_prepare_instr();
+			fp_setup_rm();
+			write_fp(f32_mulAdd(f32(RS1), f32(RS2), f32_neg(f32(RS3))));
+			fp_finish_instr();
+		} break;
 
-        case Opcode::FCVT_W_D: {
-            REQUIRE_ISA(D_ISA_EXT);
-            fp_prepare_instr();
-            fp_setup_rm();
-            regs[RD] = f64_to_i32(fp_regs.f64(RS1), softfloat_roundingMode, true);
-            fp_finish_instr();
-        } break;
+		case Opcode::FNMADD_S: {
+			REQUIRE_ISA(F_ISA_EXT);
+			fp_prepare_instr();
+			fp_setup_rm();
+			write_fp(f32_mulAdd(f32_neg(f32(RS1)), f32(RS2), f32_neg(f32(RS3))));
+			fp_finish_instr();
+		} break;
 
-        case Opcode::FCVT_WU_D: {
-            REQUIRE_ISA(D_ISA_EXT);
-            fp_prepare_instr();
-            fp_setup_rm();
-            regs[RD] = (int32_t)f64_to_ui32(fp_regs.f64(RS1), softfloat_roundingMode, true);
-            fp_finish_instr();
-        } break;
+		case Opcode::FNMSUB_S: {
+			REQUIRE_ISA(F_ISA_EXT);
+			fp_prepare_instr();
+			fp_setup_rm();
+			write_fp(f32_mulAdd(f32_neg(f32(RS1)), f32(RS2), f32(RS3)));
+			fp_finish_instr();
+		} break;
 
-        case Opcode::FCVT_D_W: {
-            REQUIRE_ISA(D_ISA_EXT);
-            fp_prepare_instr();
-            fp_setup_rm();
-            fp_regs.write(RD, i32_to_f64((int32_t)regs[RS1]));
-            fp_finish_instr();
-        } break;
+		case Opcode::FCVT_W_S: {
+			REQUIRE_ISA(F_ISA_EXT);
+			fp_prepare_instr();
+			fp_setup_rm();
+			write_int(f32_to_i32(f32(RS1), softfloat_roundingMode, true));
+			fp_finish_instr();
+		} break;
 
-        case Opcode::FCVT_D_WU: {
-            REQUIRE_ISA(D_ISA_EXT);
-            fp_prepare_instr();
-            fp_setup_rm();
-            fp_regs.write(RD, ui32_to_f64((int32_t)regs[RS1]));
-            fp_finish_instr();
-        } break;
+		case Opcode::FCVT_WU_S: {
+			REQUIRE_ISA(F_ISA_EXT);
+			fp_prepare_instr();
+			fp_setup_rm();
+			write_int(f32_to_ui32(f32(RS1), softfloat_roundingMode, true));
+			fp_finish_instr();
+		} break;
 
-        // privileged instructions
+		case Opcode::FCVT_S_W: {
+			REQUIRE_ISA(F_ISA_EXT);
+			fp_prepare_instr();
+			fp_setup_rm();
+			write_fp(i32_to_f32(concretize(int_reg(RS1))));
+			fp_finish_instr();
+		} break;
 
-#endif
-        case Opcode::WFI:
-            // NOTE: only a hint, can be implemented as NOP
-            // std::cout << "[sim:wfi] CSR mstatus.mie " << csrs.mstatus->mie << std::endl;
-            release_lr_sc_reservation();
+		case Opcode::FCVT_S_WU: {
+			REQUIRE_ISA(F_ISA_EXT);
+			fp_prepare_instr();
+			fp_setup_rm();
+			write_fp(ui32_to_f32(concretize(int_reg(RS1))));
+			fp_finish_instr();
+		} break;
 
-            if (s_mode() && csrs.mstatus.tw)
-                raise_trap(EXC_ILLEGAL_INSTR, instr.data());
+		case Opcode::FSGNJ_S: {
+			REQUIRE_ISA(F_ISA_EXT);
+			fp_prepare_instr();
+			auto f1 = f32(RS1);
+			auto f2 = f32(RS2);
+			write_fp(float32_t{(f1.v & ~F32_SIGN_BIT) | (f2.v & F32_SIGN_BIT)});
+			fp_set_dirty();
+		} break;
 
-            if (u_mode() && csrs.misa.has_supervisor_mode_extension())
-                raise_trap(EXC_ILLEGAL_INSTR, instr.data());
+		case Opcode::FSGNJN_S: {
+			REQUIRE_ISA(F_ISA_EXT);
+			fp_prepare_instr();
+			auto f1 = f32(RS1);
+			auto f2 = f32(RS2);
+			write_fp(float32_t{(f1.v & ~F32_SIGN_BIT) | (~f2.v & F32_SIGN_BIT)});
+			fp_set_dirty();
+		} break;
 
-            if (!ignore_wfi && !has_local_pending_enabled_interrupts())
-                sc_core::wait(wfi_event);
-            break;
+		case Opcode::FSGNJX_S: {
+			REQUIRE_ISA(F_ISA_EXT);
+			fp_prepare_instr();
+			auto f1 = f32(RS1);
+			auto f2 = f32(RS2);
+			write_fp(float32_t{f1.v ^ (f2.v & F32_SIGN_BIT)});
+			fp_set_dirty();
+		} break;
 
-#if 0
-        case Opcode::SFENCE_VMA:
-            if (s_mode() && csrs.mstatus.tvm)
-                raise_trap(EXC_ILLEGAL_INSTR, instr.data());
-            mem->flush_tlb();
-            break;
+		case Opcode::FMV_W_X: {
+			REQUIRE_ISA(F_ISA_EXT);
+			fp_prepare_instr();
+			write_fp(float32_t{concretize(int_reg(RS1))});
+			fp_set_dirty();
+		} break;
 
-        case Opcode::URET:
-            if (!csrs.misa.has_user_mode_extension())
-                raise_trap(EXC_ILLEGAL_INSTR, instr.data());
-            return_from_trap_handler(UserMode);
-            break;
+		case Opcode::FMV_X_W: {
+			REQUIRE_ISA(F_ISA_EXT);
+			fp_prepare_instr();
+			if (fp_tainted & (1U << RS1))
+				tainted_operand = true;
+			write_int(fp_regs.u32(RS1));
+		} break;
 
-        case Opcode::SRET:
-            if (!csrs.misa.has_supervisor_mode_extension() || (s_mode() && csrs.mstatus.tsr))
-                raise_trap(EXC_ILLEGAL_INSTR, instr.data());
-            return_from_trap_handler(SupervisorMode);
-            break;
-#endif
+		case Opcode::FEQ_S: {
+			REQUIRE_ISA(F_ISA_EXT);
+			fp_prepare_instr();
+			write_int(f32_eq(f32(RS1), f32(RS2)));
+			fp_update_exception_flags();
+		} break;
 
-        case Opcode::MRET:
-            return_from_trap_handler(MachineMode);
-            break;
+		case Opcode::FLT_S: {
+			REQUIRE_ISA(F_ISA_EXT);
+			fp_prepare_instr();
+			write_int(f32_lt(f32(RS1), f32(RS2)));
+			fp_update_exception_flags();
+		} break;
 
-#if 0
-            // instructions accepted by decoder but not by this RV32IMACF ISS -> do normal trap
-            // RV64I
-        case Opcode::LWU:
-        case Opcode::LD:
-        case Opcode::SD:
-        case Opcode::ADDIW:
-        case Opcode::SLLIW:
-        case Opcode::SRLIW:
-        case Opcode::SRAIW:
-        case Opcode::ADDW:
-        case Opcode::SUBW:
-        case Opcode::SLLW:
-        case Opcode::SRLW:
-        case Opcode::SRAW:
-            // RV64M
-        case Opcode::MULW:
-        case Opcode::DIVW:
-        case Opcode::DIVUW:
-        case Opcode::REMW:
-        case Opcode::REMUW:
-            // RV64A
-        case Opcode::LR_D:
-        case Opcode::SC_D:
-        case Opcode::AMOSWAP_D:
-        case Opcode::AMOADD_D:
-        case Opcode::AMOXOR_D:
-        case Opcode::AMOAND_D:
-        case Opcode::AMOOR_D:
-        case Opcode::AMOMIN_D:
-        case Opcode::AMOMAX_D:
-        case Opcode::AMOMINU_D:
-        case Opcode::AMOMAXU_D:
-            // RV64F
-        case Opcode::FCVT_L_S:
-        case Opcode::FCVT_LU_S:
-        case Opcode::FCVT_S_L:
-        case Opcode::FCVT_S_LU:
-            // RV64D
-        case Opcode::FCVT_L_D:
-        case Opcode::FCVT_LU_D:
-        case Opcode::FMV_X_D:
-        case Opcode::FCVT_D_L:
-        case Opcode::FCVT_D_LU:
-        case Opcode::FMV_D_X:
-            RAISE_ILLEGAL_INSTRUCTION();
-            break;
+		case Opcode::FLE_S: {
+			REQUIRE_ISA(F_ISA_EXT);
+			fp_prepare_instr();
+			write_int(f32_le(f32(RS1), f32(RS2)));
+			fp_update_exception_flags();
+		} break;
 
-#endif
-        default:
-            throw std::runtime_error("unknown opcode");
-	}
+		case Opcode::FCLASS_S: {
+			REQUIRE_ISA(F_ISA_EXT);
+			fp_prepare_instr();
+			write_int(f32_classify(f32(RS1)));
+		} break;
 
-	coverage->cover(last_pc, tainted_operand, symbolic_operand, initial_concretization);
+		default:
+			throw std::runtime_error("unknown floating-point opcode");
+	}
 }
 
 uint64_t ISS::_compute_and_get_current_cycles() {
@@ -1648,6 +2103,47 @@ void ISS::init(instr_memory_if *instr_mem, data_memory_if *data_mem, clint_if *c
 	pc = entrypoint;
 }
 
+void ISS::save_state() {
+	sync_registers();
+	saved.regs = regs.regs;
+	saved.fp_regs = fp_regs;
+	saved.fp_tainted = fp_tainted;
+	saved.csrs = csrs;
+	saved.prv = prv;
+	saved.pc = pc;
+}
+
+void ISS::restore_state() {
+	for (size_t i = 0; i < saved.regs.size(); i++)
+		regs.write(i, saved.regs[i]);
+	fp_regs = saved.fp_regs;
+	fp_tainted = saved.fp_tainted;
+	flush_decoded();
+
+	// The register_mapping of the csr_table points to members of the
+	// table itself, hence it must be retained when copying the table.
+	auto mapping = std::move(csrs.register_mapping);
+	csrs = saved.csrs;
+	csrs.register_mapping = std::move(mapping);
+
+	prv = saved.prv;
+	pc = saved.pc;
+	last_pc = saved.pc;
+
+	op = Opcode::UNDEF;
+	instr = Instruction(0);
+	lr_sc_counter = 0;
+	shall_exit = false;
+	status = CoreExecStatus::Runnable;
+
+	cycle_counter = sc_core::SC_ZERO_TIME;
+	quantum_keeper.reset();
+
+	concrete_mode = false;
+	if (regs.is_concrete())
+		switch_to_concrete();
+}
+
 void ISS::sys_exit() {
 	shall_exit = true;
 }
@@ -1661,6 +2157,7 @@ unsigned ISS::get_syscall_register_index() {
 
 
 uint64_t ISS::read_register(unsigned idx) {
+	sync_registers();
 	auto reg = regs.read(idx);
 	return solver.getValue<uint32_t>(reg->concrete);
 }
@@ -1669,6 +2166,9 @@ void ISS::write_register(unsigned idx, uint64_t value) {
 	assert(value <= UINT32_MAX);
 	auto reg = solver.BVC(std::nullopt, (uint32_t)value);
 	regs.write(idx, reg);
+
+	if (concrete_mode)
+		cregs.at(idx) = (uint32_t)value;
 }
 
 uint64_t ISS::get_progam_counter(void) {
@@ -1706,6 +2206,7 @@ uint64_t ISS::get_hart_id() {
 std::vector<uint64_t> ISS::get_registers(void) {
     std::vector<uint64_t> regvals;
 
+    sync_registers();
     for (auto v : regs.regs) {
         auto regval = solver.getValue<uint32_t>(v->concrete);
         regvals.push_back(regval);
@@ -2033,6 +2534,20 @@ void ISS::performance_and_sync_update(Opcode::Mapping executed_op) {
 	}
 }
 
+void ISS::performance_and_sync_update(size_t num_instr, sc_core::sc_time cycles) {
+	total_num_instr += num_instr;
+
+	if (!csrs.mcountinhibit.IR)
+		csrs.instret.reg += num_instr;
+
+	if (!csrs.mcountinhibit.CY)
+		cycle_counter += cycles;
+
+	quantum_keeper.inc(cycles);
+	if (quantum_keeper.need_sync())
+		quantum_keeper.sync();
+}
+
 void ISS::run_step() {
 	assert(solver.getValue<uint32_t>(regs.read(0)->concrete) == 0);
 
@@ -2045,7 +2560,8 @@ void ISS::run_step() {
 
 	last_pc = pc;
 	try {
-		exec_step();
+		if (summaries.empty() || !exec_summary())
+			exec_step();
 
 		auto x = compute_pending_interrupts();
 		if (x.target_mode != NoneMode) {
@@ -2062,7 +2578,16 @@ void ISS::run_step() {
 	// NOTE: writes to zero register are supposedly allowed but must be ignored
 	// (reset it after every instruction, instead of checking *rd != zero*
 	// before every register write)
-	regs.write(regs.zero, solver.BVC(std::nullopt, (uint32_t)0));
+	if (concrete_mode) {
+		cregs[RegFile::zero] = 0;
+	} else {
+		regs.write(regs.zero, REG_ZERO);
+
+		// Return to the concrete engine once symbolic values are
+		// no longer referenced by any register.
+		if (regs.is_concrete())
+			switch_to_concrete();
+	}
 
 	// Do not use a check *pc == last_pc* here. The reason is that due to
 	// interrupts *pc* can be set to *last_pc* accidentally (when jumping back
@@ -2075,9 +2600,12 @@ void ISS::run_step() {
 
 void ISS::run() {
 	// run a single step until either a breakpoint is hit or the execution
-	// terminates
+	// terminates, use translated blocks while in concrete mode
 	do {
-		run_step();
+		if (concrete_mode && !debug_mode && !trace && lr_sc_counter == 0)
+			run_block();
+		else
+			run_step();
 	} while (status == CoreExecStatus::Runnable);
 
 	// force sync to make sure that no action is missed
@@ -2088,6 +2616,7 @@ void ISS::show() {
 	boost::io::ios_flags_saver ifs(std::cout);
 	std::cout << "=[ core : " << csrs.mhartid.reg << " ]===========================" << std::endl;
 	std::cout << "simulation time: " << sc_core::sc_time_stamp() << std::endl;
+	sync_registers();
 	regs.show();
 	std::cout << "pc = " << std::hex << pc << std::endl;
 	std::cout << "num-instr = " << std::dec << csrs.instret.reg << std::endl;
@@ -46,11 +46,13 @@
 #include "core/common/irq_if.h"
 #include "core/common/trap.h"
 #include "core/common/debug.h"
+#include "core/common/snapshot_if.h"
 #include "csr.h"
 #include "fp.h"
 #include "mem_if.h"
 #include "syscall_if.h"
 #include "symbolic_context.h"
+#include "symbolic_explore.h"
 #include "util/common.h"
 
 #include <assert.h>
@@ -62,6 +64,7 @@
 #include <map>
 #include <memory>
 #include <stdexcept>
+#include <unordered_map>
 #include <unordered_set>
 #include <vector>
 
@@ -80,6 +83,10 @@ struct RegFile {
 	typedef std::shared_ptr<clover::ConcolicValue> RegValue;
 	std::array<RegValue, NUM_REGS> regs;
 
+	// Bit mask of registers holding a value which has a symbolic
+	// part or is tainted, maintained by write() and taint().
+	uint32_t symbolic_regs = 0;
+
 	RegFile(clover::Solver &_solver, clover::Trace &_trace);
 
 	RegFile(clover::Solver &_solver, clover::Trace &_trace, const RegFile &other);
@@ -90,6 +97,12 @@ struct RegFile {
 
 	RegFile::RegValue shamt(uint32_t index);
 
+	void taint(uint32_t index);
+
+	bool is_concrete() {
+		return symbolic_regs == 0;
+	}
+
 	const RegValue &operator[](const uint32_t idx);
 
 	void show();
@@ -192,12 +205,54 @@ struct InstructionBuffer {
 	}
 };
 
+// Decoded instruction, see ISS::decode_instr.
+struct DecodedInstr {
+	Instruction instr;
+	Opcode::Mapping op = Opcode::UNDEF;
+	uint8_t size = 0;  // zero if not decoded
+
+	// Immediate operand as concolic value, created on first use.
+	// Instructions have at most one immediate operand. For JAL and
+	// JALR the link address, for AUIPC the result is stored instead.
+	std::shared_ptr<clover::ConcolicValue> imm;
+};
+
+// Sequence of instructions executed as a whole by the concrete
+// execution engine, see translate.cpp.
+struct TranslatedBlock {
+	struct MicroOp {
+		Instruction instr;
+		Opcode::Mapping op;
+		uint8_t size;
+	};
+
+	uint32_t start, end;
+	std::vector<MicroOp> ops;
+	sc_core::sc_time cycles;
+	Coverage::CoverPlan cover;
+
+	// Cleared if the block is modified, possibly while executing it.
+	bool valid = true;
+};
+
+// Decoded instructions of a page of instruction memory. Instructions
+// are aligned to two bytes, hence there is one entry per halfword.
+struct DecodedPage {
+	static constexpr unsigned SHIFT = 12;
+	static constexpr uint32_t SIZE = 1 << SHIFT;
+
+	std::array<DecodedInstr, SIZE / 2> instrs;
+
+	// Translated blocks within this page.
+	std::vector<std::shared_ptr<TranslatedBlock>> blocks;
+};
+
 struct PendingInterrupts {
 	PrivilegeLevel target_mode;
 	uint32_t pending;
 };
 
-struct ISS : public external_interrupt_target, public clint_interrupt_target, public iss_syscall_if, public debug_target_if {
+struct ISS : public external_interrupt_target, public clint_interrupt_target, public iss_syscall_if, public debug_target_if, public snapshot_if {
 	clover::Solver &solver;
 	clover::ExecutionContext &ctx;
 	clover::Trace &tracer;
@@ -208,6 +263,16 @@ struct ISS : public external_interrupt_target, public clint_interrupt_target, pu
 	syscall_emulator_if *sys = nullptr;  // optional, if provided, the iss will intercept and handle syscalls directly
 	RegFile regs;
 	FpRegs fp_regs;
+	uint32_t fp_tainted = 0;  // bit mask, see exec_step_fp
+
+	// Plain register file of the concrete execution engine, used while
+	// no register holds symbolic or tainted data (see exec_step_concrete).
+	// Registers written in concrete mode are marked in cregs_dirty and
+	// only transferred to the concolic register file on a mode switch.
+	std::array<uint32_t, RegFile::NUM_REGS> cregs;
+	uint32_t cregs_dirty = 0;
+	bool concrete_mode = false;
+
 	uint32_t pc = 0;
 	uint32_t last_pc = 0;
 	bool trace = false;
@@ -223,10 +288,28 @@ struct ISS : public external_interrupt_target, public clint_interrupt_target, pu
 	Instruction instr;
 	Opcode::Mapping op;
 
+	// Cache of decoded instructions, indexed by page number. Entries
+	// are invalidated on stores and flushed by FENCE.I. The current
+	// instruction is referenced by decoded, which points to
+	// decoded_uncached if the cache cannot be used.
+	std::unordered_map<uint32_t, std::unique_ptr<DecodedPage>> decoded_pages;
+	DecodedPage *last_decoded_page = nullptr;
+	uint32_t last_decoded_page_num = 0;
+	DecodedInstr decoded_uncached;
+	DecodedInstr *decoded = nullptr;
+
+	// Translated blocks, indexed by start address (see run_block).
+	std::unordered_map<uint32_t, std::shared_ptr<TranslatedBlock>> blocks;
+
 	CoreExecStatus status = CoreExecStatus::Runnable;
 	std::unordered_set<uint32_t> breakpoints;
 	bool debug_mode = false;
 
+	// Host-side implementations of library functions, indexed by the
+	// entry address of the function (see summaries.cpp).
+	typedef bool (*FunctionSummary)(ISS &);
+	std::unordered_map<uint32_t, FunctionSummary> summaries;
+
 	sc_core::sc_event wfi_event;
 
 	std::string systemc_name;
@@ -235,17 +318,62 @@ struct ISS : public external_interrupt_target, public clint_interrupt_target, pu
 	sc_core::sc_time cycle_counter;  // use a separate cycle counter, since cycle count can be inhibited
 	std::array<sc_core::sc_time, Opcode::NUMBER_OF_INSTRUCTIONS> instr_cycles;
 
+	// architectural state as saved by save_state()
+	struct {
+		std::array<RegFile::RegValue, RegFile::NUM_REGS> regs;
+		FpRegs fp_regs;
+		uint32_t fp_tainted;
+		csr_table csrs;
+		PrivilegeLevel prv;
+		uint32_t pc;
+	} saved;
+
 	static constexpr int32_t REG_MIN = INT32_MIN;
     static constexpr unsigned xlen = 32;
 
 	ISS(SymbolicContext &_ctx, uint32_t hart_id, bool use_E_base_isa = false);
 
+	DecodedInstr *decode_instr(uint32_t addr);
+	DecodedPage *get_decoded_page(uint32_t page_num, bool create);
+	void invalidate_decoded(uint64_t addr, size_t num_bytes);
+	void flush_decoded();
+	std::shared_ptr<clover::ConcolicValue> imm_operand(uint32_t value);
+
 	void exec_step();
+	bool exec_summary();
+	void add_summary(uint32_t addr, const std::string &name);
+
+	bool exec_step_concrete();
+
+	std::shared_ptr<TranslatedBlock> translate_block(uint32_t start);
+	void run_block();
+
+	// Instruction fetches access physical memory, i.e. instructions
+	// can be cached by address.
+	inline bool fetch_is_physical() {
+		return csrs.satp.mode == SATP_MODE_BARE || prv == MachineMode;
+	}
+	void exec_step_fp(bool &tainted_operand, bool &initial_concretization);
+
+	void switch_to_concrete();
+	void switch_to_concolic();
+	void sync_registers();
+
+	inline void write_concrete(uint32_t index, uint32_t value) {
+		cregs[index] = value;
+		cregs_dirty |= 1U << index;
+	}
+
+	void load_concrete(uint32_t index, std::shared_ptr<clover::ConcolicValue> value);
+	void branch_concrete(bool cond);
 
 	uint64_t _compute_and_get_current_cycles();
 
 	void init(instr_memory_if *instr_mem, data_memory_if *data_mem, clint_if *clint, uint32_t entrypoint, uint32_t sp);
 
+	void save_state() override;
+	void restore_state() override;
+
 	void trigger_external_interrupt(PrivilegeLevel level) override;
 
 	void clear_external_interrupt(PrivilegeLevel level) override;
@@ -262,28 +390,33 @@ struct ISS : public external_interrupt_target, public clint_interrupt_target, pu
 
     std::vector<uint64_t> get_registers(void) override;
 
-    bool eval(std::shared_ptr<clover::BitVector> bv) {
-        auto q = tracer.getQuery(bv);
-        return solver.eval(q);
+    bool eval(const clover::ConcreteValue &value) {
+        return value.value != 0;
     };
 
     void track_and_trace_branch(bool cond, std::shared_ptr<clover::ConcolicValue> expr) {
         if (expr->symbolic.has_value())
-            tracer.add(cond, *expr->symbolic);
+            tracer.add(cond, *expr->symbolic, last_pc);
     };
 
     void make_symbolic(size_t index) override {
         std::string name = "x" + std::to_string(index);
+        switch_to_concolic();
         regs.write(index, ctx.getSymbolicWord(name));
     }
 
     void make_symbolic(uint32_t addr, size_t size) override {
         std::string name = std::string("memory") + "<" + std::to_string(addr) + ">";
 
-        auto saddr = solver.BVC(std::nullopt, addr);
-        auto value = ctx.getSymbolicBytes(name, size);
+        // Bytes are created and stored separately since concolic
+        // values are limited to 64 bit, names are the same as for
+        // getSymbolicBytes.
+        for (size_t i = 0; i < size; i++) {
+            auto saddr = solver.BVC(std::nullopt, (uint32_t)(addr + i));
+            auto value = ctx.getSymbolicByte(name + ":byte" + std::to_string(i));
 
-        mem->symbolic_store_data(saddr, value, size);
+            mem->symbolic_store_data(saddr, value, sizeof(uint8_t));
+        }
     }
 
     Architecture get_architecture(void) override {
@@ -339,13 +472,17 @@ struct ISS : public external_interrupt_target, public clint_interrupt_target, pu
 	}
 
 	template <unsigned Alignment, bool isLoad>
-	inline void trap_check_addr_alignment(std::shared_ptr<clover::ConcolicValue> addr) {
-		auto caddr = solver.getValue<uint32_t>(addr->concrete);
-		if (unlikely(caddr % Alignment)) {
-			raise_trap(isLoad ? EXC_LOAD_ADDR_MISALIGNED : EXC_STORE_AMO_ADDR_MISALIGNED, caddr);
+	inline void trap_check_addr_alignment(uint32_t addr) {
+		if (unlikely(addr % Alignment)) {
+			raise_trap(isLoad ? EXC_LOAD_ADDR_MISALIGNED : EXC_STORE_AMO_ADDR_MISALIGNED, addr);
 		}
 	}
 
+	template <unsigned Alignment, bool isLoad>
+	inline void trap_check_addr_alignment(std::shared_ptr<clover::ConcolicValue> addr) {
+		trap_check_addr_alignment<Alignment, isLoad>(solver.getValue<uint32_t>(addr->concrete));
+	}
+
 	inline void execute_amo(Instruction &instr, std::function<int32_t(int32_t, int32_t)> operation) {
 		throw std::string(__func__) + " not implemented";
 	}
@@ -381,6 +518,7 @@ struct ISS : public external_interrupt_target, public clint_interrupt_target, pu
 	void switch_to_trap_handler(PrivilegeLevel target_mode);
 
 	void performance_and_sync_update(Opcode::Mapping executed_op);
+	void performance_and_sync_update(size_t num_instr, sc_core::sc_time cycles);
 
 	void run_step() override;
 
@@ -403,14 +541,18 @@ struct DirectCoreRunner : public sc_core::sc_module {
 	}
 
 	void run() {
-		core.run();
-
-		if (core.status == CoreExecStatus::HitBreakpoint) {
-			throw std::runtime_error(
-			    "Breakpoints are not supported in the direct runner, use the debug "
-			    "runner instead.");
-		}
-		assert(core.status == CoreExecStatus::Terminated);
+		// In snapshot mode, all paths are executed by this thread and
+		// the platform state is restored in between (see symbolic_explore).
+		do {
+			core.run();
+
+			if (core.status == CoreExecStatus::HitBreakpoint) {
+				throw std::runtime_error(
+				    "Breakpoints are not supported in the direct runner, use the debug "
+				    "runner instead.");
+			}
+			assert(core.status == CoreExecStatus::Terminated);
+		} while (symbolic_snapshot_enabled() && symbolic_next_path());
 
 		sc_core::sc_stop();
 	}
@@ -16,18 +16,17 @@
  */
 
 #include <assert.h>
-#include <nlohmann/json.hpp>
 #include <filesystem>
 #include <iostream>
 
 #include "coverage.h"
 
 using namespace rv32;
-using namespace nlohmann;
 
-void SourceLine::to_json(json &out) {
-	json j;
+// Keys of JSON objects are written in sorted order to match
+// the output of nlohmann::json (see JsonWriter).
 
+void SourceLine::to_json(JsonWriter &out) {
 	auto has_unexecuted_block = [this](void) {
 		if (exec_count == 0)
 			return true;
@@ -40,53 +39,70 @@ void SourceLine::to_json(json &out) {
 		return false;
 	};
 
-	j["branches"] = json::array();
-	j["count"] = exec_count;
-	j["line_number"] = definition.line;
-	j["unexecuted_block"] = has_unexecuted_block();
-	j["function_name"] = func_name;
-	j["symex/tainted_once"] = tainted_once;
-	j["symex/symbolic_once"] = symbolic_once;
-	j["symex/initial_concretization"] = initial_conc;
-
-	out.push_back(j);
+	// Each conditional branch has two arcs in the gcov format.
+	out.begin_object();
+	out.key("branches");
+	out.begin_array();
+	for (auto branch : branches) {
+		out.begin_object();
+		out.member("count", branch->not_taken);
+		out.member("fallthrough", true);
+		out.member("throw", false);
+		out.end_object();
+
+		out.begin_object();
+		out.member("count", branch->taken);
+		out.member("fallthrough", false);
+		out.member("throw", false);
+		out.end_object();
+	}
+	out.end_array();
+	out.member("count", (uint64_t)exec_count);
+	out.member("function_name", func_name);
+	out.member("line_number", definition.line);
+	out.member("symex/initial_concretization", initial_conc);
+	out.member("symex/symbolic_once", symbolic_once);
+	out.member("symex/tainted_once", tainted_once);
+	out.member("unexecuted_block", has_unexecuted_block());
+	out.end_object();
 }
 
-void Function::to_json(json &out) {
+void Function::to_json(JsonWriter &out) {
 	size_t visited = 0;
 	for (auto block : blocks)
 		if (block->visited) visited++;
 
-	out.push_back({
-		{"blocks", blocks.size()},
-		{"blocks_executed", visited},
-		{"demangled_name", name},
-		{"end_column", definition.second.column},
-		{"end_line", definition.second.line},
-		{"execution_count", exec_count},
-		{"name", name},
-		{"start_column", definition.first.column},
-		{"start_line", definition.first.line},
-	});
+	out.begin_object();
+	out.member("blocks", (uint64_t)blocks.size());
+	out.member("blocks_executed", (uint64_t)visited);
+	out.member("demangled_name", name);
+	out.member("end_column", definition.second.column);
+	out.member("end_line", definition.second.line);
+	out.member("execution_count", (uint64_t)exec_count);
+	out.member("name", name);
+	out.member("start_column", definition.first.column);
+	out.member("start_line", definition.first.line);
+	out.end_object();
 }
 
-void SourceFile::to_json(json &out) {
-	json j;
-	json jlines;
-	json jfuncs;
-
-	for (auto &l : lines) {
-		l.second.to_json(jlines);
-	}
+void SourceFile::to_json(JsonWriter &out) {
+	out.begin_object();
+	out.member("file", std::filesystem::path(name).filename().string());
 
+	out.key("functions");
+	out.begin_array();
 	for (auto &p : funcs) {
 		Function &f = p.second;
-		f.to_json(jfuncs);
+		f.to_json(out);
 	}
+	out.end_array();
 
-	j["file"] = std::filesystem::path(name).filename();
-	j["lines"] = jlines;
-	j["functions"] = jfuncs;
+	out.key("lines");
+	out.begin_array();
+	for (auto &l : lines) {
+		l.second.to_json(out);
+	}
+	out.end_array();
 
-	out.push_back(j);
+	out.end_object();
 }
@@ -0,0 +1,110 @@
+/*
+ * Copyright (c) 2021 Group of Computer Architecture, University of Bremen
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <assert.h>
+#include <nlohmann/json.hpp>
+
+#include "json_writer.h"
+
+using namespace rv32;
+
+void JsonWriter::newline(void) {
+	if (indent == 0)
+		return;
+
+	out.put('\n');
+	for (size_t i = 0; i < empty.size() * indent; i++)
+		out.put(' ');
+}
+
+// Separates the following value from the previous one.
+void JsonWriter::prefix(void) {
+	if (after_key) {
+		after_key = false;
+		return;
+	} else if (empty.empty()) {
+		return; /* top-level value */
+	}
+
+	if (!empty.back())
+		out.put(',');
+	empty.back() = false;
+
+	newline();
+}
+
+void JsonWriter::begin_object(void) {
+	prefix();
+	out.put('{');
+	empty.push_back(true);
+}
+
+void JsonWriter::end(char c) {
+	assert(!empty.empty() && !after_key);
+
+	bool was_empty = empty.back();
+	empty.pop_back();
+	if (!was_empty)
+		newline();
+	out.put(c);
+}
+
+void JsonWriter::end_object(void) {
+	end('}');
+}
+
+void JsonWriter::begin_array(void) {
+	prefix();
+	out.put('[');
+	empty.push_back(true);
+}
+
+void JsonWriter::end_array(void) {
+	end(']');
+}
+
+void JsonWriter::key(const std::string &k) {
+	value(k);
+	out << ((indent) ? ": " : ":");
+	after_key = true;
+}
+
+void JsonWriter::value(const std::string &v) {
+	prefix();
+	// Use nlohmann::json for consistent escaping of strings.
+	out << nlohmann::json(v).dump();
+}
+
+void JsonWriter::value(bool v) {
+	prefix();
+	out << ((v) ? "true" : "false");
+}
+
+void JsonWriter::value(int64_t v) {
+	prefix();
+	out << v;
+}
+
+void JsonWriter::value(uint64_t v) {
+	prefix();
+	out << v;
+}
+
+void JsonWriter::value(double v) {
+	prefix();
+	out << v;
+}
@@ -0,0 +1,79 @@
+/*
+ * Copyright (c) 2021 Group of Computer Architecture, University of Bremen
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef RISCV_VP_JSON_WRITER_H
+#define RISCV_VP_JSON_WRITER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace rv32 {
+
+// Writes JSON directly to an output stream without building a DOM.
+// The output is identical to nlohmann::json::dump() with the same
+// indentation, provided that object keys are written in sorted order.
+// An indentation of zero creates compact output on a single line.
+class JsonWriter {
+private:
+	std::ostream &out;
+	unsigned indent;
+
+	// For each open object or array, whether it is still empty.
+	std::vector<bool> empty;
+	bool after_key = false;
+
+	void prefix(void);
+	void newline(void);
+	void end(char);
+
+public:
+	JsonWriter(std::ostream &_out, unsigned _indent)
+		: out(_out), indent(_indent) {}
+
+	void begin_object(void);
+	void end_object(void);
+	void begin_array(void);
+	void end_array(void);
+
+	void key(const std::string &);
+
+	void value(const std::string &);
+	void value(bool);
+	void value(int64_t);
+	void value(uint64_t);
+	void value(double);
+	void value(int v) {
+		value((int64_t)v);
+	}
+	void value(const char *v) {
+		value(std::string(v));
+	}
+
+	template <typename T>
+	void member(const std::string &k, T v) {
+		key(k);
+		value(v);
+	}
+};
+
+}
+
+#endif
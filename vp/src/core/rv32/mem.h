@@ -187,6 +187,7 @@ struct CombinedMemoryInterface : public sc_core::sc_module,
 
 		if (!done)
 			_do_transaction(tlm::TLM_WRITE_COMMAND, addr, (uint8_t *)&value, sizeof(T));
+		iss.invalidate_decoded(addr, sizeof(T));
 #if 0
 		atomic_unlock();
 #endif
@@ -200,6 +201,7 @@ struct CombinedMemoryInterface : public sc_core::sc_module,
 		auto vaddr = v2p(caddr, STORE);
 
 		_do_transaction(tlm::TLM_WRITE_COMMAND, vaddr, data, num_bytes);
+		iss.invalidate_decoded(vaddr, num_bytes);
 	}
 
 	Concolic symbolic_load_data(Concolic addr, size_t num_bytes) override {
@@ -0,0 +1,206 @@
+/*
+ * Copyright (c) 2021 Group of Computer Architecture, University of Bremen
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <optional>
+#include <stdexcept>
+
+#include "iss.h"
+
+using namespace rv32;
+
+// Host-side implementations of library functions. Invoked on entry
+// of the function instead of executing its instructions. Return
+// false, without modifying any state, if the arguments cannot be
+// handled, the original function is executed in this case.
+//
+// The implementations track the same decisions as a straightforward
+// byte-wise implementation of the function. A decision is only added
+// to the execution tree if it depends on symbolic input, i.e. at most
+// one branch per symbolic character is created. Since the decisions
+// are always made in the same order, the execution tree remains
+// consistent across paths.
+
+typedef std::shared_ptr<clover::ConcolicValue> Concolic;
+
+// Maximum amount of bytes accessed at once, larger accesses would
+// lose the symbolic part of the accessed data (see SymbolicMemory).
+#define MAX_ACCESS_SIZE 8
+
+static std::optional<uint32_t>
+concrete_arg(ISS &iss, unsigned index) {
+	if (iss.concrete_mode)
+		return iss.cregs[index];
+
+	auto value = iss.regs[index];
+	if (value->symbolic.has_value())
+		return std::nullopt;
+	return iss.solver.getValue<uint32_t>(value->concrete);
+}
+
+static Concolic
+arg(ISS &iss, unsigned index) {
+	if (iss.concrete_mode)
+		return iss.solver.BVC(std::nullopt, iss.cregs[index]);
+	return iss.regs[index];
+}
+
+static void
+set_result(ISS &iss, Concolic value) {
+	if (iss.concrete_mode)
+		iss.load_concrete(RegFile::a0, value);
+	else
+		iss.regs.write(RegFile::a0, value);
+}
+
+static Concolic
+load(ISS &iss, uint32_t addr, size_t size) {
+	return iss.mem->symbolic_load_data(iss.solver.BVC(std::nullopt, addr), size);
+}
+
+static void
+store(ISS &iss, uint32_t addr, Concolic value, size_t size) {
+	iss.mem->symbolic_store_data(iss.solver.BVC(std::nullopt, addr), value, size);
+}
+
+// Tracks a decision of the summarized function, cond is the
+// concolic value of the decision for the current input.
+static bool
+decide(ISS &iss, Concolic cond) {
+	bool taken = iss.eval(cond->concrete);
+	iss.track_and_trace_branch(taken, cond);
+	return taken;
+}
+
+static bool
+summarize_memcpy(ISS &iss) {
+	auto dest = concrete_arg(iss, RegFile::a0);
+	auto src = concrete_arg(iss, RegFile::a1);
+	auto n = concrete_arg(iss, RegFile::a2);
+	if (!dest.has_value() || !src.has_value() || !n.has_value())
+		return false;
+
+	for (uint32_t off = 0; off < *n; off += MAX_ACCESS_SIZE) {
+		size_t size = std::min(*n - off, (uint32_t)MAX_ACCESS_SIZE);
+		store(iss, *dest + off, load(iss, *src + off, size), size);
+	}
+
+	return true; // dest is returned, a0 is unchanged
+}
+
+static bool
+summarize_memset(ISS &iss) {
+	auto s = concrete_arg(iss, RegFile::a0);
+	auto n = concrete_arg(iss, RegFile::a2);
+	if (!s.has_value() || !n.has_value())
+		return false;
+
+	auto c = arg(iss, RegFile::a1)->extract(0, 8);
+	auto chunk = c;
+	for (size_t i = 1; i < MAX_ACCESS_SIZE; i++)
+		chunk = chunk->concat(c);
+
+	for (uint32_t off = 0; off < *n; off += MAX_ACCESS_SIZE) {
+		size_t size = std::min(*n - off, (uint32_t)MAX_ACCESS_SIZE);
+		auto value = (size == MAX_ACCESS_SIZE) ? chunk : chunk->extract(0, size * 8);
+		store(iss, *s + off, value, size);
+	}
+
+	return true; // s is returned, a0 is unchanged
+}
+
+static bool
+summarize_strlen(ISS &iss) {
+	auto s = concrete_arg(iss, RegFile::a0);
+	if (!s.has_value())
+		return false;
+
+	auto zero = iss.solver.BVC(std::nullopt, (uint8_t)0);
+
+	uint32_t len = 0;
+	while (!decide(iss, load(iss, *s + len, 1)->eq(zero)))
+		len++;
+
+	set_result(iss, iss.solver.BVC(std::nullopt, len));
+	return true;
+}
+
+static bool
+summarize_strcmp(ISS &iss) {
+	auto s1 = concrete_arg(iss, RegFile::a0);
+	auto s2 = concrete_arg(iss, RegFile::a1);
+	if (!s1.has_value() || !s2.has_value())
+		return false;
+
+	auto zero = iss.solver.BVC(std::nullopt, (uint8_t)0);
+
+	Concolic c1, c2;
+	for (uint32_t off = 0;; off++) {
+		c1 = load(iss, *s1 + off, 1);
+		c2 = load(iss, *s2 + off, 1);
+
+		// Single decision per character: continue with the next one?
+		auto cont = c1->eq(c2)->band(c1->ne(zero));
+		if (!decide(iss, cont))
+			break;
+	}
+
+	set_result(iss, c1->zext(32)->sub(c2->zext(32)));
+	return true;
+}
+
+static const std::unordered_map<std::string, ISS::FunctionSummary> summary_table = {
+	{"memcpy", summarize_memcpy},
+	{"memset", summarize_memset},
+	{"strlen", summarize_strlen},
+	{"strcmp", summarize_strcmp},
+};
+
+void ISS::add_summary(uint32_t addr, const std::string &name) {
+	auto it = summary_table.find(name);
+	if (it == summary_table.end())
+		throw std::invalid_argument("no summary available for function '" + name + "'");
+
+	summaries[addr] = it->second;
+}
+
+// Invoked before executing the instruction at pc. Returns true if
+// the function starting at pc was executed by its summary, control
+// is transferred to the return address in this case.
+bool ISS::exec_summary() {
+	auto it = summaries.find(pc);
+	if (it == summaries.end())
+		return false;
+
+	auto ra = concrete_arg(*this, RegFile::ra);
+	if (!ra.has_value() || !it->second(*this))
+		return false;
+
+	if (trace)
+		printf("core %2u: prv %1x: pc %8x: <summary>\n", csrs.mhartid.reg, prv, last_pc);
+
+	// Account the summary as a single return instruction. Summarized
+	// functions are not covered, only the edge to the caller is
+	// recorded as feedback for the search strategy.
+	op = Opcode::JALR;
+	pc = *ra & ~1;
+
+	coverage->cover_edge(last_pc, pc);
+	return true;
+}
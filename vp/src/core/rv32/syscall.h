@@ -103,11 +103,12 @@
 #include <systemc>
 
 #include "iss.h"
+#include "snapshot_if.h"
 #include "syscall_if.h"
 
 namespace rv32 {
 
-struct SyscallHandler : public sc_core::sc_module, syscall_emulator_if {
+struct SyscallHandler : public sc_core::sc_module, syscall_emulator_if, snapshot_if {
 	tlm_utils::simple_target_socket<SyscallHandler> tsock;
 	std::unordered_map<uint64_t, iss_syscall_if *> cores;
 
@@ -165,6 +166,20 @@ struct SyscallHandler : public sc_core::sc_module, syscall_emulator_if {
 		return max_heap - start_heap;
 	}
 
+	// heap pointer as saved by save_state()
+	uint64_t saved_hp = 0;
+
+	void save_state() override {
+		saved_hp = hp;
+	}
+
+	void restore_state() override {
+		hp = saved_hp;
+		max_heap = saved_hp;
+		shall_exit = false;
+		shall_break = false;
+	}
+
 	void init(uint8_t *host_memory_pointer, uint64_t mem_start_address, uint64_t heap_pointer_address) {
 		mem = host_memory_pointer;
 		mem_offset = mem_start_address;
@@ -0,0 +1,228 @@
+/*
+ * Copyright (c) 2021 Group of Computer Architecture, University of Bremen
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+
+#include <iostream>
+
+#include "iss.h"
+
+using namespace rv32;
+
+// Execution of basic blocks by the concrete execution engine. A block
+// is translated once into a sequence of decoded instructions, which is
+// then executed without fetching, decoding, and updating coverage and
+// timing information for each instruction. Blocks end after a control
+// flow transfer and before instructions which are not supported by
+// exec_step_concrete, basic block leaders (see Coverage), and entry
+// points of function summaries. Blocks never cross a page boundary
+// and are invalidated together with the decoded instructions of the
+// page (see ISS::invalidate_decoded).
+
+// Upper bound on the amount of instructions in a block, limits the
+// delay of interrupts.
+#define MAX_BLOCK_SIZE 64
+
+// Instructions which (may) transfer control or flush the block.
+static bool
+is_block_end(Opcode::Mapping op) {
+	switch (op) {
+		case Opcode::JAL:
+		case Opcode::JALR:
+		case Opcode::BEQ:
+		case Opcode::BNE:
+		case Opcode::BLT:
+		case Opcode::BGE:
+		case Opcode::BLTU:
+		case Opcode::BGEU:
+		case Opcode::FENCE_I:
+			return true;
+		default:
+			return false;
+	}
+}
+
+// Instructions supported by exec_step_concrete.
+static bool
+translatable(Opcode::Mapping op) {
+	switch (op) {
+		case Opcode::ADDI:
+		case Opcode::SLTI:
+		case Opcode::SLTIU:
+		case Opcode::XORI:
+		case Opcode::ORI:
+		case Opcode::ANDI:
+		case Opcode::ADD:
+		case Opcode::SUB:
+		case Opcode::SLL:
+		case Opcode::SLT:
+		case Opcode::SLTU:
+		case Opcode::SRL:
+		case Opcode::SRA:
+		case Opcode::XOR:
+		case Opcode::OR:
+		case Opcode::AND:
+		case Opcode::SLLI:
+		case Opcode::SRLI:
+		case Opcode::SRAI:
+		case Opcode::LUI:
+		case Opcode::AUIPC:
+		case Opcode::MUL:
+		case Opcode::MULH:
+		case Opcode::MULHU:
+		case Opcode::MULHSU:
+		case Opcode::DIV:
+		case Opcode::DIVU:
+		case Opcode::REM:
+		case Opcode::REMU:
+		case Opcode::SB:
+		case Opcode::SH:
+		case Opcode::SW:
+		case Opcode::LB:
+		case Opcode::LH:
+		case Opcode::LW:
+		case Opcode::LBU:
+		case Opcode::LHU:
+		case Opcode::FENCE:
+			return true;
+		default:
+			return is_block_end(op);
+	}
+}
+
+std::shared_ptr<TranslatedBlock> ISS::translate_block(uint32_t start) {
+	auto block = std::make_shared<TranslatedBlock>();
+	block->start = start;
+
+	uint32_t page_end = (start & ~(DecodedPage::SIZE - 1)) + DecodedPage::SIZE;
+	std::vector<uint64_t> addrs;
+
+	uint32_t addr = start;
+	while (block->ops.size() < MAX_BLOCK_SIZE) {
+		if (addr != start && coverage->is_leader(addr))
+			break;
+		if (summaries.find(addr) != summaries.end())
+			break;
+
+		DecodedInstr *d;
+		try {
+			d = decode_instr(addr);
+		} catch (SimulationTrap &e) {
+			break; // raised by run_step once executed
+		}
+
+		if (!translatable(d->op) || addr + d->size > page_end)
+			break;
+		if (d->size == 2 && !(csrs.misa.reg & C_ISA_EXT))
+			break;
+
+		block->ops.push_back({d->instr, d->op, d->size});
+		block->cycles += instr_cycles[d->op];
+		addrs.push_back(addr);
+
+		addr += d->size;
+		if (is_block_end(d->op))
+			break;
+	}
+
+	block->end = addr;
+	block->cover = coverage->prepare_cover(addrs);
+	return block;
+}
+
+// Executes the block starting at pc in concrete mode. Falls back to
+// run_step if no block can be translated at pc.
+void ISS::run_block() {
+	std::shared_ptr<TranslatedBlock> block;
+	if (fetch_is_physical()) {
+		auto it = blocks.find(pc);
+		if (it != blocks.end()) {
+			block = it->second;
+		} else {
+			block = translate_block(pc);
+			if (!block->ops.empty()) {
+				blocks[pc] = block;
+				get_decoded_page(pc >> DecodedPage::SHIFT, true)->blocks.push_back(block);
+			}
+		}
+	}
+
+	if (!block || block->ops.empty()) {
+		run_step();
+		return;
+	}
+
+	size_t executed = 0;
+	bool trapped = false;
+	try {
+		for (auto &uop : block->ops) {
+			last_pc = pc;
+			instr = uop.instr;
+			op = uop.op;
+			pc += uop.size;
+
+			executed++;
+			bool supported = exec_step_concrete();
+			assert(supported);
+			(void)supported;
+			cregs[RegFile::zero] = 0;
+
+			// Stop if a symbolic value has been loaded (see
+			// load_concrete), the block has been modified, or
+			// the program exited.
+			if (!concrete_mode || !block->valid || shall_exit)
+				break;
+		}
+
+		auto x = compute_pending_interrupts();
+		if (x.target_mode != NoneMode) {
+			prepare_interrupt(x);
+			switch_to_trap_handler(x.target_mode);
+		}
+	} catch (SimulationTrap &e) {
+		if (trace)
+			std::cout << "take trap " << e.reason << ", mtval=" << e.mtval << std::endl;
+		auto target_mode = prepare_trap(e);
+		switch_to_trap_handler(target_mode);
+		trapped = true;
+	}
+
+	if (!concrete_mode)
+		regs.write(regs.zero, solver.BVConst((uint32_t)0));
+
+	// An instruction raising a trap is accounted, but not covered
+	// (same as in run_step).
+	size_t covered = (trapped) ? executed - 1 : executed;
+	if (covered == block->ops.size()) {
+		coverage->cover_block(block->cover);
+		performance_and_sync_update(executed, block->cycles);
+	} else {
+		sc_core::sc_time cycles;
+		uint32_t addr = block->start;
+		for (size_t i = 0; i < executed; i++) {
+			auto &uop = block->ops[i];
+			if (i < covered)
+				coverage->cover(addr, false, false, false);
+			cycles += instr_cycles[uop.op];
+			addr += uop.size;
+		}
+		performance_and_sync_update(executed, cycles);
+	}
+
+	if (shall_exit)
+		status = CoreExecStatus::Terminated;
+}
@@ -79,11 +79,13 @@ public:
 	addr_t sys_end_addr = 0x020103ff;
 
 	bool quiet = false;
+	std::vector<std::string> summaries;
 
 	SymexOptions(void) {
 		// clang-format off
 		add_options()
-			("quiet", po::bool_switch(&quiet), "do not output register values on exit");
+			("quiet", po::bool_switch(&quiet), "do not output register values on exit")
+			("summarize", po::value<std::vector<std::string>>(&summaries), "execute given library function (memcpy, memset, strlen, strcmp) natively");
         	// clang-format on
         }
 
@@ -122,6 +124,14 @@ int sc_main(int argc, char **argv) {
 
 	if (opt.intercept_syscalls)
 		core.sys = &sys;
+	for (auto &name : opt.summaries) {
+		auto sym = loader.get_symbol(name.c_str());
+		if (!sym) {
+			std::cerr << "Symbol '" << name << "' not found, cannot summarize it" << std::endl;
+			return 1;
+		}
+		core.add_summary(sym->st_value, name);
+	}
 
 	// setup port mapping
 	bus.ports[0] = new PortMapping(opt.mem_start_addr, opt.mem_end_addr);
@@ -158,6 +168,19 @@ int sc_main(int argc, char **argv) {
 	if (opt.quiet)
 		 sc_core::sc_report_handler::set_verbosity_level(sc_core::SC_NONE);
 
+	if (symbolic_snapshot_enabled()) {
+		if (opt.use_debug_runner) {
+			std::cerr << "Snapshot mode not supported by debug runner" << std::endl;
+			return 1;
+		}
+
+		symbolic_snapshot_register(&core);
+		symbolic_snapshot_register(&mem);
+		symbolic_snapshot_register(&clint);
+		symbolic_snapshot_register(&sys);
+		symbolic_snapshot_save();
+	}
+
 	bool newcov;
 	Coverage *coverage;
 	if (symbolic_context.user_data) {
@@ -170,7 +193,32 @@ int sc_main(int argc, char **argv) {
 	coverage->instr_mem = instr_mem_if;
 	if (newcov) {
 		symbolic_context.user_data = coverage;
+		symbolic_context.dump_user_data = [coverage](std::ostream &out) {
+			coverage->dump(out);
+		};
+		symbolic_context.merge_user_data = [coverage](std::istream &in) {
+			coverage->merge(in);
+		};
+		symbolic_context.location_score = [coverage](uint64_t pc, bool taken) {
+			return coverage->unvisited_blocks(pc, taken);
+		};
+		symbolic_context.score_version = [coverage](void) {
+			return coverage->visited_version();
+		};
+		symbolic_context.begin_path = [coverage](void) {
+			coverage->begin_path();
+		};
+		symbolic_context.new_coverage = [coverage](void) {
+			return coverage->path_new_edges();
+		};
+		symbolic_context.checkpoint = [coverage](const std::string &fp, bool wait) {
+			coverage->checkpoint(fp, wait);
+		};
 		coverage->init();
+
+		auto checkpoint = symbolic_checkpoint_file();
+		if (checkpoint.has_value() && symbolic_resume_enabled())
+			coverage->resume(*checkpoint);
 	}
 	core.coverage = coverage;
 
@@ -1,7 +1,5 @@
 #include <clover/clover.h>
 
-#include "fns.h"
-
 using namespace clover;
 
 BitVector::BitVector(const klee::ref<klee::Expr> &_expr)
@@ -10,17 +8,6 @@ BitVector::BitVector(const klee::ref<klee::Expr> &_expr)
 	return;
 }
 
-BitVector::BitVector(IntValue value)
-{
-	size_t bytesize, bitsize;
-
-	bytesize = intByteSize(value);
-	bitsize = bytesize * 8;
-
-	uint64_t exprValue = intToUint(value);
-	this->expr = klee::ConstantExpr::create(exprValue, (unsigned)bitsize);
-}
-
 BitVector::BitVector(const klee::Array *array)
 {
 	unsigned bitsize;
@@ -1,21 +1,30 @@
 #include <assert.h>
 #include <stdlib.h>
 
+#include <algorithm>
+
 #include <clover/clover.h>
 
 using namespace clover;
 
-#define CHECK_BRANCH(BRANCH, ...) \
-	(BRANCH && BRANCH->getRandomPath(__VA_ARGS__))
-
-Trace::Branch::Branch(void)
+Trace::Branch::Branch(Branch *_parent)
 {
 	/* This is node is a placeholder */
 	bv = nullptr;
 	wasNegated = false;
+	wasUnsat = false;
+	collapsed = false;
+	pending = false;
 
+	parent = _parent;
 	true_branch = nullptr;
 	false_branch = nullptr;
+
+	id = 0;
+	depth = 0;
+	location = 0;
+	unexplored = false;
+	inFrontier = false;
 }
 
 bool
@@ -25,45 +34,45 @@ Trace::Branch::isPlaceholder(void)
 }
 
 bool
-Trace::Branch::getRandomPath(Path &path)
+Trace::Branch::isExhausted(void)
 {
-	if (this->isPlaceholder())
+	if (collapsed || isPlaceholder() || inFrontier || pending)
 		return false;
 
-	// Second part of pair is modified by index later
-	path.push_back(std::make_pair(this->bv, false));
-	size_t idx = path.size() - 1;
+	/* If a branch was never taken, it is only considered explored if
+	 * it is known to be unsat. Otherwise, it was either negated by a
+	 * different process or the negation didn't lead to the expected
+	 * path. In both cases it might still be taken in the future. */
+	for (auto b : { true_branch, false_branch }) {
+		if (b && !b->collapsed)
+			return false;
+		else if (!b && !wasUnsat)
+			return false;
+	}
 
-	/* XXX: This prefers node in the upper tree */
-	if (!wasNegated && (!this->true_branch || !this->false_branch)) {
-		path[idx].second = (this->true_branch != nullptr);
-		if (path[idx].second)
-			assert(this->false_branch == nullptr);
+	return true;
+}
 
-		wasNegated = true;
-		return true; /* Found undiscovered path */
-	}
+void
+Trace::Branch::collapse(void)
+{
+	assert(!inFrontier);
 
-	/* Randomly traverse true or false branch first */
-	int random = rand();
-	if (random % 2 == 0) {
-		if (CHECK_BRANCH(true_branch, path)) {
-			path[idx].second = true;
-			return true;
-		} else if (CHECK_BRANCH(false_branch, path)) {
-			path[idx].second = false;
-			return true;
-		}
-	} else {
-		if (CHECK_BRANCH(false_branch, path)) {
-			path[idx].second = false;
-			return true;
-		} else if (CHECK_BRANCH(true_branch, path)) {
-			path[idx].second = true;
-			return true;
-		}
-	}
+	collapsed = true;
+	bv = nullptr;
+	true_branch = nullptr;
+	false_branch = nullptr;
+}
+
+void
+Trace::Branch::getPath(Path &path)
+{
+	assert(!isPlaceholder());
+	path.push_back(std::make_pair(bv, true_branch != nullptr));
+
+	Branch *node = this;
+	for (Branch *p = parent; p; node = p, p = p->parent)
+		path.push_back(std::make_pair(p->bv, p->true_branch.get() == node));
 
-	path.pop_back(); // node is not on path
-	return false;
+	std::reverse(path.begin(), path.end());
 }
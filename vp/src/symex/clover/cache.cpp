@@ -0,0 +1,341 @@
+#include <assert.h>
+#include <stdint.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <optional>
+#include <sstream>
+#include <vector>
+
+#include <klee/Expr/Constraints.h>
+#include <klee/Solver/SolverImpl.h>
+#include <llvm/ADT/APInt.h>
+
+#include "cache.h"
+#include "serialize.h"
+
+using namespace clover;
+
+#define CACHE_MAGIC "clover-cache"
+#define CACHE_VERSION 1
+
+/* Type of a cache entry, part of the key */
+enum {
+	ENTRY_TRUTH = 'T',
+	ENTRY_VALUE = 'V',
+	ENTRY_INITIAL_VALUES = 'I',
+};
+
+class PersistentSolver : public klee::SolverImpl {
+private:
+	klee::Solver *solver;
+	std::filesystem::path dir;
+
+	/* Used to create unique names for temporary files */
+	std::atomic<uint64_t> tmpCounter;
+
+	std::string getKey(char type, const klee::Query &query,
+	                   const std::vector<const klee::Array *> *objects = nullptr);
+	std::filesystem::path getPath(const std::string &key);
+
+	std::optional<std::string> lookup(const std::string &key);
+	void insert(const std::string &key, const std::string &result);
+
+public:
+	PersistentSolver(klee::Solver *_solver, std::string _dir);
+	~PersistentSolver(void);
+
+	bool computeTruth(const klee::Query &query, bool &isValid);
+	bool computeValue(const klee::Query &query, klee::ref<klee::Expr> &result);
+	bool computeInitialValues(const klee::Query &query,
+	                          const std::vector<const klee::Array *> &objects,
+	                          std::vector<std::vector<unsigned char>> &values,
+	                          bool &hasSolution);
+	SolverRunStatus getOperationStatusCode(void);
+	char *getConstraintLog(const klee::Query &query);
+	void setCoreSolverTimeout(klee::time::Span timeout);
+};
+
+static std::string
+encodeExpr(const klee::ref<klee::Expr> &expr)
+{
+	std::ostringstream out;
+	ExprWriter writer(out);
+
+	writer.write(expr);
+	return out.str();
+}
+
+static void
+writeBytes(std::ostream &out, const std::string &bytes)
+{
+	writeUint(out, bytes.size());
+	out.write(bytes.data(), bytes.size());
+}
+
+/* 64-bit FNV-1a hash, used to name cache entries */
+static uint64_t
+hashKey(const std::string &key)
+{
+	uint64_t hash = 0xcbf29ce484222325ULL;
+	for (unsigned char c : key) {
+		hash ^= c;
+		hash *= 0x100000001b3ULL;
+	}
+
+	return hash;
+}
+
+PersistentSolver::PersistentSolver(klee::Solver *_solver, std::string _dir)
+    : solver(_solver), dir(_dir), tmpCounter(0)
+{
+	return;
+}
+
+PersistentSolver::~PersistentSolver(void)
+{
+	delete solver;
+}
+
+/* The key is independent of the order of the constraints. Arrays are
+ * identified by their name, which is assumed to be stable across runs. */
+std::string
+PersistentSolver::getKey(char type, const klee::Query &query,
+                         const std::vector<const klee::Array *> *objects)
+{
+	std::vector<std::string> constraints;
+	for (auto &c : query.constraints)
+		constraints.push_back(encodeExpr(c));
+
+	std::sort(constraints.begin(), constraints.end());
+	constraints.erase(std::unique(constraints.begin(), constraints.end()),
+	                  constraints.end());
+
+	std::ostringstream key;
+	key.put(type);
+
+	writeUint(key, constraints.size());
+	for (auto &c : constraints)
+		writeBytes(key, c);
+	writeBytes(key, encodeExpr(query.expr));
+
+	if (objects) {
+		writeUint(key, objects->size());
+		for (auto array : *objects) {
+			writeBytes(key, array->name);
+			writeUint(key, array->size);
+		}
+	}
+
+	return key.str();
+}
+
+std::filesystem::path
+PersistentSolver::getPath(const std::string &key)
+{
+	char name[17];
+	snprintf(name, sizeof(name), "%016llx", (unsigned long long)hashKey(key));
+
+	/* Use the first byte as subdirectory, avoids huge directories */
+	std::string fn(name);
+	return dir / fn.substr(0, 2) / fn.substr(2);
+}
+
+/* Returns the result stored for the given key, if any. Entries which
+ * are unreadable or belong to a different key (hash collision) are
+ * treated as cache misses. */
+std::optional<std::string>
+PersistentSolver::lookup(const std::string &key)
+{
+	std::ifstream file(getPath(key), std::ios::binary);
+	if (!file.is_open())
+		return std::nullopt;
+
+	std::string data((std::istreambuf_iterator<char>(file)),
+	                 std::istreambuf_iterator<char>());
+	std::istringstream in(data);
+
+	try {
+		char magic[sizeof(CACHE_MAGIC)];
+		if (!in.read(magic, sizeof(magic)) || std::string(magic, sizeof(magic)) != std::string(CACHE_MAGIC, sizeof(CACHE_MAGIC)))
+			return std::nullopt;
+		if (readUint(in) != CACHE_VERSION)
+			return std::nullopt;
+
+		/* Check the length first, it may be invalid */
+		if (readUint(in) != key.size())
+			return std::nullopt;
+
+		std::string entryKey(key.size(), '\0');
+		if (!in.read(entryKey.data(), entryKey.size()) || entryKey != key)
+			return std::nullopt;
+	} catch (const std::runtime_error &) {
+		return std::nullopt;
+	}
+
+	return data.substr(in.tellg());
+}
+
+/* Entries are written to a temporary file first and then renamed.
+ * Concurrent readers thus never observe partially written entries.
+ * Failing to store an entry is not an error, it is simply omitted. */
+void
+PersistentSolver::insert(const std::string &key, const std::string &result)
+{
+	std::error_code ec;
+	auto path = getPath(key);
+	std::filesystem::create_directories(path.parent_path(), ec);
+	if (ec)
+		return;
+
+	auto tmp = path;
+	tmp += ".tmp" + std::to_string(getpid()) + "-" + std::to_string(tmpCounter++);
+
+	std::ofstream file(tmp, std::ios::binary);
+	if (!file.is_open())
+		return;
+
+	file.write(CACHE_MAGIC, sizeof(CACHE_MAGIC));
+	writeUint(file, CACHE_VERSION);
+	writeBytes(file, key);
+	file.write(result.data(), result.size());
+
+	file.close();
+	if (file)
+		std::filesystem::rename(tmp, path, ec);
+	if (!file || ec)
+		std::filesystem::remove(tmp, ec);
+}
+
+bool
+PersistentSolver::computeTruth(const klee::Query &query, bool &isValid)
+{
+	auto key = getKey(ENTRY_TRUTH, query);
+	auto entry = lookup(key);
+	if (entry.has_value() && entry->size() == 1) {
+		isValid = entry->at(0) != 0;
+		return true;
+	}
+
+	if (!solver->impl->computeTruth(query, isValid))
+		return false;
+
+	insert(key, std::string(1, (char)isValid));
+	return true;
+}
+
+bool
+PersistentSolver::computeValue(const klee::Query &query, klee::ref<klee::Expr> &result)
+{
+	auto key = getKey(ENTRY_VALUE, query);
+	auto entry = lookup(key);
+	if (entry.has_value()) {
+		std::istringstream in(*entry);
+		try {
+			/* Validate sizes before allocating memory, each word is
+			 * encoded using at least one byte. */
+			uint64_t width = readUint(in);
+			uint64_t nwords = readUint(in);
+			if (nwords == 0 || nwords > entry->size() ||
+			    width > nwords * 64 || width <= (nwords - 1) * 64)
+				throw std::runtime_error("invalid cache entry");
+
+			std::vector<uint64_t> words(nwords);
+			for (auto &word : words)
+				word = readUint(in);
+
+			result = klee::ConstantExpr::alloc(llvm::APInt(width, words));
+			return true;
+		} catch (const std::runtime_error &) {
+			/* invalid entry, recompute it */
+		}
+	}
+
+	if (!solver->impl->computeValue(query, result))
+		return false;
+
+	auto ce = dyn_cast<klee::ConstantExpr>(result);
+	assert(ce && "value must be constant");
+	const llvm::APInt &value = ce->getAPValue();
+
+	std::ostringstream out;
+	writeUint(out, value.getBitWidth());
+	writeUint(out, value.getNumWords());
+	for (unsigned i = 0; i < value.getNumWords(); i++)
+		writeUint(out, value.getRawData()[i]);
+
+	insert(key, out.str());
+	return true;
+}
+
+bool
+PersistentSolver::computeInitialValues(const klee::Query &query,
+                                       const std::vector<const klee::Array *> &objects,
+                                       std::vector<std::vector<unsigned char>> &values,
+                                       bool &hasSolution)
+{
+	auto key = getKey(ENTRY_INITIAL_VALUES, query, &objects);
+	auto entry = lookup(key);
+	if (entry.has_value()) {
+		std::istringstream in(*entry);
+		try {
+			std::vector<std::vector<unsigned char>> cached;
+
+			bool sat = readUint(in) != 0;
+			for (size_t i = 0; sat && i < objects.size(); i++) {
+				if (readUint(in) != objects[i]->size)
+					throw std::runtime_error("invalid cache entry");
+
+				std::vector<unsigned char> value(objects[i]->size);
+				if (!in.read((char *)value.data(), value.size()))
+					throw std::runtime_error("truncated cache entry");
+				cached.push_back(value);
+			}
+
+			hasSolution = sat;
+			values = cached;
+			return true;
+		} catch (const std::runtime_error &) {
+			/* invalid entry, recompute it */
+		}
+	}
+
+	if (!solver->impl->computeInitialValues(query, objects, values, hasSolution))
+		return false;
+
+	std::ostringstream out;
+	writeUint(out, hasSolution);
+	for (size_t i = 0; hasSolution && i < values.size(); i++)
+		writeBytes(out, std::string(values[i].begin(), values[i].end()));
+
+	insert(key, out.str());
+	return true;
+}
+
+klee::SolverImpl::SolverRunStatus
+PersistentSolver::getOperationStatusCode(void)
+{
+	return solver->impl->getOperationStatusCode();
+}
+
+char *
+PersistentSolver::getConstraintLog(const klee::Query &query)
+{
+	return solver->impl->getConstraintLog(query);
+}
+
+void
+PersistentSolver::setCoreSolverTimeout(klee::time::Span timeout)
+{
+	solver->impl->setCoreSolverTimeout(timeout);
+}
+
+klee::Solver *
+clover::createPersistentSolver(klee::Solver *solver, std::string dir)
+{
+	return new klee::Solver(new PersistentSolver(solver, dir));
+}
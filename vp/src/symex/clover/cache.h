@@ -0,0 +1,18 @@
+#ifndef CLOVER_CACHE_H
+#define CLOVER_CACHE_H
+
+#include <string>
+
+#include <klee/Solver/Solver.h>
+
+namespace clover {
+
+/* Creates a solver which caches results of the given solver in the
+ * given directory, thereby allowing results to be reused by later
+ * runs. Each result is stored in a separate file, files are replaced
+ * atomically. Hence, the cache can be shared by concurrent processes. */
+klee::Solver *createPersistentSolver(klee::Solver *solver, std::string dir);
+
+} // namespace clover
+
+#endif
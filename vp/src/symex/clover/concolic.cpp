@@ -1,35 +1,147 @@
 #include <assert.h>
+#include <stdint.h>
 
 #include <clover/clover.h>
 
 using namespace clover;
 
-#define BINARY_OPERATOR(NAME, FN)                                                                        \
-	std::shared_ptr<ConcolicValue>                                                                   \
-	NAME(std::shared_ptr<ConcolicValue> other)                                                       \
-	{                                                                                                \
-		auto expr = builder->FN(concrete->expr, other->concrete->expr);                          \
-		auto bvv = std::make_shared<BitVector>(BitVector(expr));                                 \
-                                                                                                         \
-		auto taint = is_tainted() || other->is_tainted();                                        \
-		if (this->symbolic.has_value() || other->symbolic.has_value()) {                         \
-			auto bvs_this = this->symbolic.value_or(this->concrete);                         \
-			auto bvs_other = other->symbolic.value_or(other->concrete);                      \
-                                                                                                         \
-			auto expr = builder->FN(bvs_this->expr, bvs_other->expr);                        \
-			auto bvs = std::make_shared<BitVector>(BitVector(expr));                         \
-                                                                                                         \
-			return std::make_shared<ConcolicValue>(ConcolicValue(builder, taint, bvv, bvs)); \
-		} else {                                                                                 \
-			return std::make_shared<ConcolicValue>(ConcolicValue(builder, taint, bvv));      \
-		}                                                                                        \
+/* Operations on the native concrete representation. These must yield
+ * the same results as the corresponding klee::ConstantExpr operations
+ * (i.e. LLVM APInt semantics), except for division by zero which is
+ * defined as in SMT-LIB instead of triggering an assertion. */
+
+static inline int64_t
+toSigned(const ConcreteValue &v)
+{
+	if (v.width >= 64)
+		return (int64_t)v.value;
+
+	uint64_t msb = UINT64_C(1) << (v.width - 1);
+	return (int64_t)((v.value ^ msb) - msb);
+}
+
+static inline ConcreteValue
+boolValue(bool b)
+{
+	return ConcreteValue(b, klee::Expr::Bool);
+}
+
+#define NATIVE_OPERATOR(FN, ...)                                   \
+	static inline ConcreteValue                                \
+	native##FN(const ConcreteValue &a, const ConcreteValue &b) \
+	{                                                          \
+		assert(a.width == b.width);                        \
+		klee::Expr::Width w = a.width;                     \
+		(void)w;                                           \
+		__VA_ARGS__                                        \
+	}
+
+NATIVE_OPERATOR(Eq, return boolValue(a.value == b.value);)
+NATIVE_OPERATOR(Ne, return boolValue(a.value != b.value);)
+NATIVE_OPERATOR(Ult, return boolValue(a.value < b.value);)
+NATIVE_OPERATOR(Uge, return boolValue(a.value >= b.value);)
+NATIVE_OPERATOR(Slt, return boolValue(toSigned(a) < toSigned(b));)
+NATIVE_OPERATOR(Sge, return boolValue(toSigned(a) >= toSigned(b));)
+NATIVE_OPERATOR(Add, return ConcreteValue(a.value + b.value, w);)
+NATIVE_OPERATOR(Sub, return ConcreteValue(a.value - b.value, w);)
+NATIVE_OPERATOR(Mul, return ConcreteValue(a.value * b.value, w);)
+NATIVE_OPERATOR(And, return ConcreteValue(a.value & b.value, w);)
+NATIVE_OPERATOR(Or, return ConcreteValue(a.value | b.value, w);)
+NATIVE_OPERATOR(Xor, return ConcreteValue(a.value ^ b.value, w);)
+
+NATIVE_OPERATOR(Shl, {
+	if (b.value >= w)
+		return ConcreteValue(0, w);
+	return ConcreteValue(a.value << b.value, w);
+})
+NATIVE_OPERATOR(LShr, {
+	if (b.value >= w)
+		return ConcreteValue(0, w);
+	return ConcreteValue(a.value >> b.value, w);
+})
+NATIVE_OPERATOR(AShr, {
+	uint64_t shift = (b.value >= w) ? w - 1 : b.value;
+	return ConcreteValue((uint64_t)(toSigned(a) >> shift), w);
+})
+
+NATIVE_OPERATOR(UDiv, {
+	if (b.value == 0)
+		return ConcreteValue(UINT64_MAX, w);
+	return ConcreteValue(a.value / b.value, w);
+})
+NATIVE_OPERATOR(URem, {
+	if (b.value == 0)
+		return a;
+	return ConcreteValue(a.value % b.value, w);
+})
+NATIVE_OPERATOR(SDiv, {
+	int64_t x = toSigned(a), y = toSigned(b);
+	if (y == 0)
+		return ConcreteValue((x < 0) ? 1 : UINT64_MAX, w);
+	else if (y == -1) /* avoid overflow, result wraps around */
+		return ConcreteValue(-(uint64_t)x, w);
+	return ConcreteValue((uint64_t)(x / y), w);
+})
+NATIVE_OPERATOR(SRem, {
+	int64_t x = toSigned(a), y = toSigned(b);
+	if (y == 0)
+		return a;
+	else if (y == -1)
+		return ConcreteValue(0, w);
+	return ConcreteValue((uint64_t)(x % y), w);
+})
+
+static inline ConcreteValue
+nativeConcat(const ConcreteValue &a, const ConcreteValue &b)
+{
+	klee::Expr::Width w = a.width + b.width;
+	assert(w <= 64 && "concrete values are limited to 64 bit");
+
+	return ConcreteValue(a.value << b.width | b.value, w);
+}
+
+#define BINARY_OPERATOR(NAME, FN)                                                                         \
+	std::shared_ptr<ConcolicValue>                                                                    \
+	NAME(std::shared_ptr<ConcolicValue> other)                                                        \
+	{                                                                                                 \
+		auto conc = native##FN(concrete, other->concrete);                                        \
+                                                                                                          \
+		auto taint = is_tainted() || other->is_tainted();                                         \
+		if (this->symbolic.has_value() || other->symbolic.has_value()) {                          \
+			auto expr = builder->FN(getExpr(), other->getExpr());                             \
+			auto bvs = std::make_shared<BitVector>(BitVector(expr));                          \
+                                                                                                          \
+			return std::make_shared<ConcolicValue>(ConcolicValue(builder, taint, conc, bvs)); \
+		} else {                                                                                  \
+			return std::make_shared<ConcolicValue>(ConcolicValue(builder, taint, conc));      \
+		}                                                                                         \
 	}
 
-ConcolicValue::ConcolicValue(klee::ExprBuilder *_builder, bool _tainted, std::shared_ptr<BitVector> _concrete, std::optional<std::shared_ptr<BitVector>> _symbolic)
+ConcreteValue::ConcreteValue(uint64_t _value, klee::Expr::Width _width)
+    : width(_width)
+{
+	assert(width > 0 && width <= 64);
+	value = (width == 64) ? _value : _value & ((UINT64_C(1) << width) - 1);
+}
+
+klee::ref<klee::Expr>
+ConcreteValue::toExpr(void) const
+{
+	return klee::ConstantExpr::create(value, width);
+}
+
+ConcolicValue::ConcolicValue(klee::ExprBuilder *_builder, bool _tainted, ConcreteValue _concrete, std::optional<std::shared_ptr<BitVector>> _symbolic)
     : concrete(_concrete), symbolic(_symbolic), builder(_builder), tainted(_tainted)
 {
-	assert(isa<klee::ConstantExpr>(concrete->expr) &&
-	       "concrete part of ConcolicValue must be a ConstantExpr");
+	return;
+}
+
+klee::ref<klee::Expr>
+ConcolicValue::getExpr(void)
+{
+	if (symbolic.has_value())
+		return (*symbolic)->expr;
+	return concrete.toExpr();
 }
 
 void
@@ -48,8 +160,8 @@ unsigned
 ConcolicValue::getWidth(void)
 {
 	if (symbolic.has_value())
-		assert(concrete->expr->getWidth() == (*symbolic)->expr->getWidth());
-	return concrete->expr->getWidth();
+		assert(concrete.width == (*symbolic)->expr->getWidth());
+	return concrete.width;
 }
 
 BINARY_OPERATOR(ConcolicValue::eq, Eq)
@@ -76,67 +188,64 @@ BINARY_OPERATOR(ConcolicValue::concat, Concat)
 std::shared_ptr<ConcolicValue>
 ConcolicValue::bnot(void)
 {
-	auto expr = builder->Not(concrete->expr);
-	auto bvv = std::make_shared<BitVector>(BitVector(expr));
+	auto conc = ConcreteValue(~concrete.value, concrete.width);
 
 	auto taint = is_tainted();
 	if (this->symbolic.has_value()) {
 		auto expr = builder->Not((*symbolic)->expr);
 		auto bvs = std::make_shared<BitVector>(BitVector(expr));
 
-		return std::make_shared<ConcolicValue>(ConcolicValue(builder, taint, bvv, bvs));
+		return std::make_shared<ConcolicValue>(ConcolicValue(builder, taint, conc, bvs));
 	} else {
-		return std::make_shared<ConcolicValue>(ConcolicValue(builder, taint, bvv));
+		return std::make_shared<ConcolicValue>(ConcolicValue(builder, taint, conc));
 	}
 }
 
 std::shared_ptr<ConcolicValue>
 ConcolicValue::extract(unsigned offset, klee::Expr::Width width)
 {
-	auto expr = builder->Extract(concrete->expr, offset, width);
-	auto bvv = std::make_shared<BitVector>(BitVector(expr));
+	assert(offset + width <= concrete.width);
+	auto conc = ConcreteValue(concrete.value >> offset, width);
 
 	auto taint = is_tainted();
 	if (this->symbolic.has_value()) {
 		auto expr = builder->Extract((*symbolic)->expr, offset, width);
 		auto bvs = std::make_shared<BitVector>(BitVector(expr));
 
-		return std::make_shared<ConcolicValue>(ConcolicValue(builder, taint, bvv, bvs));
+		return std::make_shared<ConcolicValue>(ConcolicValue(builder, taint, conc, bvs));
 	} else {
-		return std::make_shared<ConcolicValue>(ConcolicValue(builder, taint, bvv));
+		return std::make_shared<ConcolicValue>(ConcolicValue(builder, taint, conc));
 	}
 }
 
 std::shared_ptr<ConcolicValue>
 ConcolicValue::sext(klee::Expr::Width width)
 {
-	auto expr = builder->SExt(concrete->expr, width);
-	auto bvv = std::make_shared<BitVector>(BitVector(expr));
+	auto conc = ConcreteValue((uint64_t)toSigned(concrete), width);
 
 	auto taint = is_tainted();
 	if (this->symbolic.has_value()) {
 		auto expr = builder->SExt((*symbolic)->expr, width);
 		auto bvs = std::make_shared<BitVector>(BitVector(expr));
 
-		return std::make_shared<ConcolicValue>(ConcolicValue(builder, taint, bvv, bvs));
+		return std::make_shared<ConcolicValue>(ConcolicValue(builder, taint, conc, bvs));
 	} else {
-		return std::make_shared<ConcolicValue>(ConcolicValue(builder, taint, bvv));
+		return std::make_shared<ConcolicValue>(ConcolicValue(builder, taint, conc));
 	}
 }
 
 std::shared_ptr<ConcolicValue>
 ConcolicValue::zext(klee::Expr::Width width)
 {
-	auto expr = builder->ZExt(concrete->expr, width);
-	auto bvv = std::make_shared<BitVector>(BitVector(expr));
+	auto conc = ConcreteValue(concrete.value, width);
 
 	auto taint = is_tainted();
 	if (this->symbolic.has_value()) {
 		auto expr = builder->ZExt((*symbolic)->expr, width);
 		auto bvs = std::make_shared<BitVector>(BitVector(expr));
 
-		return std::make_shared<ConcolicValue>(ConcolicValue(builder, taint, bvv, bvs));
+		return std::make_shared<ConcolicValue>(ConcolicValue(builder, taint, conc, bvs));
 	} else {
-		return std::make_shared<ConcolicValue>(ConcolicValue(builder, taint, bvv));
+		return std::make_shared<ConcolicValue>(ConcolicValue(builder, taint, conc));
 	}
 }
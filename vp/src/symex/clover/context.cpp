@@ -1,6 +1,8 @@
 #include <assert.h>
 #include <stdlib.h>
 
+#include <stdexcept>
+
 #include <clover/clover.h>
 
 using namespace clover;
@@ -58,6 +60,9 @@ ExecutionContext::getSymbolicBytes(std::string name, size_t size)
 {
 	std::shared_ptr<ConcolicValue> result = nullptr;
 
+	if (size > sizeof(uint64_t))
+		throw std::invalid_argument("symbolic values are limited to 64 bit");
+
 	for (size_t i = 0; i < size; i++) {
 		std::string bname = name + ":byte" + std::to_string(i);
 		auto symbyte = getSymbolicByte(bname);
@@ -11,4 +11,6 @@ size_t intByteSize(clover::IntValue v);
 uint64_t intToUint(clover::IntValue v);
 clover::IntValue intFromVector(std::vector<unsigned char> vector);
 
+clover::ConcreteStore storeFromAssignment(const klee::Assignment &assign);
+
 #endif
@@ -12,21 +12,25 @@
 #include <klee/Solver/Solver.h>
 
 #include <fstream>
+#include <functional>
 #include <map>
 #include <memory>
 #include <optional>
+#include <set>
+#include <unordered_map>
 #include <variant>
+#include <vector>
 
 namespace clover {
 
 typedef std::variant<uint8_t, uint32_t> IntValue;
+typedef std::map<std::string, IntValue> ConcreteStore;
 
 class BitVector {
 private:
 	klee::ref<klee::Expr> expr;
 
 	BitVector(const klee::ref<klee::Expr> &expr);
-	BitVector(IntValue value);
 	BitVector(const klee::Array *array);
 
 	std::shared_ptr<BitVector> eqTrue(void);
@@ -37,9 +41,20 @@ private:
 	friend class Trace;
 };
 
+/* Concrete bit vector of at most 64 bit, represented natively to
+ * avoid allocating KLEE expressions for operations on concrete values.
+ * Bits above the width are always zero. */
+struct ConcreteValue {
+	uint64_t value;
+	klee::Expr::Width width;
+
+	ConcreteValue(uint64_t _value, klee::Expr::Width _width);
+	klee::ref<klee::Expr> toExpr(void) const;
+};
+
 class ConcolicValue {
 public:
-	std::shared_ptr<BitVector> concrete;
+	ConcreteValue concrete;
 	std::optional<std::shared_ptr<BitVector>> symbolic;
 
 	void taint(void);
@@ -78,9 +93,12 @@ private:
 
 	ConcolicValue(klee::ExprBuilder *_builder,
 	              bool _tainted,
-	              std::shared_ptr<BitVector> _concrete,
+	              ConcreteValue _concrete,
 	              std::optional<std::shared_ptr<BitVector>> _symbolic = std::nullopt);
 
+	/* Symbolic expression or, if not symbolic, the concrete one. */
+	klee::ref<klee::Expr> getExpr(void);
+
 	/* The solver acts as a factory for ConcolicValue */
 	friend class Solver;
 };
@@ -91,16 +109,40 @@ private:
 	klee::ArrayCache array_cache;
 	klee::ExprBuilder *builder = NULL;
 
+	/* Shared concrete values, created on first use by BVConst */
+	static constexpr int32_t CONST_MIN = -256;
+	static constexpr int32_t CONST_MAX = 255;
+	std::shared_ptr<ConcolicValue> consts8[UINT8_MAX + 1];
+	std::shared_ptr<ConcolicValue> consts32[CONST_MAX - CONST_MIN + 1];
+
+	/* Expressions of a loaded trace must use the same array cache */
+	friend class Trace;
+
 public:
-	Solver(klee::Solver *_solver = NULL);
+	/* If cacheDir is given, results of the core solver are stored
+	 * in this directory and reused by later Solver instances. In
+	 * incremental mode, constraints of a path prefix shared with
+	 * the previous query remain asserted in the core solver. */
+	Solver(klee::Solver *_solver = NULL,
+	       std::optional<std::string> cacheDir = std::nullopt,
+	       bool incremental = false);
 	~Solver(void);
 
 	void setTimeout(klee::time::Span timeout);
 	std::optional<klee::Assignment> getAssignment(const klee::Query &query);
 
+	/* Returns a store for a query serialized by Trace::takePending,
+	 * may be invoked by a different process than the Trace. */
+	std::optional<ConcreteStore> solveSerialized(const std::string &query);
+
 	bool eval(const klee::Query &query);
 	std::shared_ptr<ConcolicValue> BVC(std::optional<std::string> name, IntValue value);
 
+	/* Returns a concrete value which may be shared with other users,
+	 * small values are only allocated once per Solver. Contrary to
+	 * values created by BVC, the returned value must not be tainted. */
+	std::shared_ptr<ConcolicValue> BVConst(IntValue value);
+
 	/* Methods for converting between concolic values and uint8_t buffers */
 	std::shared_ptr<ConcolicValue> BVC(uint8_t *buf, size_t buflen);
 	void BVCToBytes(std::shared_ptr<ConcolicValue> value, uint8_t *buf, size_t buflen);
@@ -118,36 +160,176 @@ public:
 
 	/* Convert the concrete part of a ConcolicValue to a C type. */
 	template <typename T>
-	T getValue(std::shared_ptr<BitVector> bv)
+	T getValue(const ConcreteValue &concrete)
 	{
-		// Since we don't have constraints here, these function
-		// only works on ConstantExpr as provided by ->concrete.
-		klee::ConstantExpr *ce = dyn_cast<klee::ConstantExpr>(bv->expr);
-		assert(ce && "getValue only works on constants");
-
-		return ce->getZExtValue(sizeof(T) * 8);
+		assert(concrete.width <= sizeof(T) * 8 && "Value may be out of range!");
+		return (T)concrete.value;
 	}
 };
 
+/* Memory is organized in pages which store the concrete value of each
+ * byte. Bytes which have a symbolic part or are tainted are additionally
+ * stored in a sparse per-page overlay. Accesses to bytes which are not
+ * part of the overlay do not require the creation of KLEE expressions. */
 class ConcolicMemory {
 private:
 	typedef uint32_t Addr;
 
+	static constexpr unsigned PAGE_BITS = 12;
+	static constexpr size_t PAGE_SIZE = 1UL << PAGE_BITS;
+	static constexpr Addr PAGE_MASK = PAGE_SIZE - 1;
+
+	struct Page {
+		uint8_t concrete[PAGE_SIZE] = {0};
+		std::unordered_map<uint16_t, std::shared_ptr<ConcolicValue>> overlay;
+
+		/* Whether the page has been recorded in undo */
+		bool recorded = false;
+	};
+
 	Solver &solver;
-	std::unordered_map<Addr, std::shared_ptr<ConcolicValue>> data;
+	std::unordered_map<Addr, std::unique_ptr<Page>> pages;
+
+	/* Most recently accessed page, avoids a lookup for successive
+	 * accesses to the same page. Invalidated if pages are replaced. */
+	Addr lastPageNum;
+	Page *lastPage;
+
+	/* Original content of all pages modified since the last call to
+	 * save(). A nullptr value denotes a previously unallocated page. */
+	std::optional<std::unordered_map<Addr, std::unique_ptr<Page>>> undo;
+
+	Page *getPage(Addr addr);
+	Page *modifyPage(Addr addr);
+	bool hasOverlay(Page *page, Addr addr, unsigned bytesize);
+	std::shared_ptr<ConcolicValue> loadByte(Addr addr);
+	void storeByte(Addr addr, std::shared_ptr<ConcolicValue> byte);
 
 public:
 	ConcolicMemory(Solver &_solver);
 	void reset(void);
 
+	/* Save the current memory content. Afterwards, all stores are
+	 * recorded and can be reverted using restore(). The runtime of
+	 * restore() is proportional to the amount of modified pages. */
+	void save(void);
+	void restore(void);
+
 	std::shared_ptr<ConcolicValue> load(Addr addr, unsigned bytesize);
 	std::shared_ptr<ConcolicValue> load(std::shared_ptr<ConcolicValue> addr, unsigned bytesize);
 
 	void store(Addr addr, std::shared_ptr<ConcolicValue> value, unsigned bytesize);
 	void store(std::shared_ptr<ConcolicValue> addr, std::shared_ptr<ConcolicValue> value, unsigned bytesize);
+
+	/* Store the given concrete bytes, buf may be NULL to store zeros. */
+	void storeConcrete(Addr addr, const uint8_t *buf, size_t size);
 };
 
-typedef std::map<std::string, IntValue> ConcreteStore;
+/* Node of the execution tree for which only one branch has been taken
+ * so far and which has not been negated yet. Search strategies decide
+ * which of these nodes is negated next to discover a new path. */
+struct FrontierNode {
+	uint64_t id;       /* consecutive number, assigned on creation */
+	size_t depth;      /* amount of branches on the path to this node */
+	uint64_t location; /* branch location, e.g. program counter */
+	bool unexplored;   /* direction of the branch not taken so far */
+};
+
+class SearchStrategy {
+public:
+	virtual ~SearchStrategy(void) {}
+
+	virtual void add(FrontierNode *node) = 0;
+	virtual void remove(FrontierNode *node) = 0;
+	virtual bool empty(void) = 0;
+
+	/* Removes and returns the node which should be negated next.
+	 * Must only be called if the frontier is not empty. */
+	virtual FrontierNode *select(void) = 0;
+};
+
+/* Scores the unexplored direction of a branch at the given location */
+typedef std::function<uint64_t(uint64_t, bool)> ScoreFunction;
+
+/* Returns strategy for the given name (dfs, bfs, random, or guided)
+ * or nullptr if there is no strategy with the given name. The score
+ * and version functions are only used by the guided strategy. */
+std::unique_ptr<SearchStrategy> newStrategy(std::string name, ScoreFunction score,
+                                            std::function<uint64_t(void)> version = nullptr);
+
+/* Uniformly random node of the frontier. */
+class RandomStrategy : public SearchStrategy {
+protected:
+	std::vector<FrontierNode *> nodes;
+	std::unordered_map<FrontierNode *, size_t> indices;
+
+public:
+	void add(FrontierNode *node) override;
+	void remove(FrontierNode *node) override;
+	bool empty(void) override;
+	FrontierNode *select(void) override;
+};
+
+/* Deepest node, most recently created nodes first. */
+class DepthFirstStrategy : public SearchStrategy {
+private:
+	struct Compare {
+		bool operator()(const FrontierNode *a, const FrontierNode *b) const;
+	};
+	std::set<FrontierNode *, Compare> nodes;
+
+public:
+	void add(FrontierNode *node) override;
+	void remove(FrontierNode *node) override;
+	bool empty(void) override;
+	FrontierNode *select(void) override;
+};
+
+/* Shallowest node, least recently created nodes first. */
+class BreadthFirstStrategy : public SearchStrategy {
+private:
+	struct Compare {
+		bool operator()(const FrontierNode *a, const FrontierNode *b) const;
+	};
+	std::set<FrontierNode *, Compare> nodes;
+
+public:
+	void add(FrontierNode *node) override;
+	void remove(FrontierNode *node) override;
+	bool empty(void) override;
+	FrontierNode *select(void) override;
+};
+
+/* Node with the highest score, as determined by the given function of
+ * the node location and its unexplored direction (e.g. based on coverage
+ * information). Ties are broken by depth. Scores are cached until the
+ * value returned by the version function changes. Without a version
+ * function, they are recomputed on each invocation of select. */
+class GuidedStrategy : public SearchStrategy {
+private:
+	typedef std::pair<uint64_t, FrontierNode *> Entry;
+	struct Compare {
+		bool operator()(const Entry &a, const Entry &b) const;
+	};
+
+	ScoreFunction score;
+	std::function<uint64_t(void)> version;
+
+	std::optional<uint64_t> scoredVersion;
+	std::map<std::pair<uint64_t, bool>, uint64_t> scores;
+	std::unordered_map<FrontierNode *, uint64_t> nodeScores;
+	std::set<Entry, Compare> nodes;
+
+	uint64_t getScore(FrontierNode *node);
+	void rescore(void);
+
+public:
+	GuidedStrategy(ScoreFunction _score, std::function<uint64_t(void)> _version);
+	void add(FrontierNode *node) override;
+	void remove(FrontierNode *node) override;
+	bool empty(void) override;
+	FrontierNode *select(void) override;
+};
 
 /**
  * The Tracer fullfills two tasks:
@@ -164,25 +346,34 @@ typedef std::map<std::string, IntValue> ConcreteStore;
  */
 class Trace {
 private:
-	class Branch {
+	class Branch : public FrontierNode {
 	public:
 		typedef std::pair<std::shared_ptr<BitVector>, bool> PathElement;
 		typedef std::vector<PathElement> Path;
 
 		std::shared_ptr<BitVector> bv;
 		bool wasNegated; /* Don't negate nodes twice (could be unsat) */
+		bool wasUnsat;   /* Negation of this node is unsat */
+		bool collapsed;  /* Subtree has been fully explored and freed */
+		bool pending;    /* Negation is being solved, see takePending */
 
+		Branch *parent;
 		std::shared_ptr<Branch> true_branch;
 		std::shared_ptr<Branch> false_branch;
 
-		Branch(void);
+		bool inFrontier;
+
+		Branch(Branch *_parent = NULL);
 		bool isPlaceholder(void);
 
-		/* Returns seemingly random path to a node in the tree
-		 * for which either the false or the true branch wasn't
-		 * attempted to be taken yet. If no such node exists,
-		 * false is returned. */
-		bool getRandomPath(Path &path);
+		/* Whether all paths through this node have been explored,
+		 * if so the subtree rooted at this node can be collapsed. */
+		bool isExhausted(void);
+		void collapse(void);
+
+		/* Returns path from the root of the tree to this node.
+		 * The last element refers to the taken branch. */
+		void getPath(Path &path);
 	};
 
 	Solver &solver;
@@ -192,21 +383,73 @@ private:
 	std::shared_ptr<Branch> pathCondsRoot;
 	std::shared_ptr<Branch> pathCondsCurrent;
 
+	/* Nodes which haven't been negated yet and for which only
+	 * one branch has been taken so far. Maintained by add(). */
+	std::unique_ptr<SearchStrategy> frontier;
+	uint64_t nextId;
+
+	/* Node negated by the last invocation of findNewPath. The path
+	 * resulting from the negation may not have been executed yet. */
+	Branch *lastNegated;
+
+	/* Nodes returned by takePending, indexed by their id */
+	std::unordered_map<uint64_t, Branch *> pending;
+
+	/* Amount of branches on the current path and amount of
+	 * branches at the start of each path which must not be
+	 * negated (see setExploredPrefix). */
+	size_t pathDepth;
+	size_t exploredPrefix;
+
 	/* Create new query for path in execution tree. */
 	klee::Query newQuery(klee::ConstraintSet &cs, Branch::Path &path);
 
+	void addFrontier(Branch *node);
+	void removeFrontier(Branch *node);
+
+	/* Collapse exhausted subtrees, starting at given node. */
+	void prune(Branch *node);
+	void finishPath(void);
+
 public:
 	Trace(Solver &_solver);
 	void reset(void);
 
 	/* Add bv as constraint to ConstraintSet and as node in tree. */
-	void add(bool condition, std::shared_ptr<BitVector> bv);
+	void add(bool condition, std::shared_ptr<BitVector> bv, uint64_t location = 0);
+
+	/* Strategy used by findNewPath, must be set before the first
+	 * node is added. Defaults to RandomStrategy. */
+	void setStrategy(std::unique_ptr<SearchStrategy> strategy);
 
 	/* Create query from BitVector with currently tracked constraints. */
 	klee::Query getQuery(std::shared_ptr<BitVector> bv);
 
-	std::optional<klee::Assignment> findNewPath(void);
+	/* Find assignment for a new path, if pathLength is not NULL
+	 * it is set to the amount of branches on the new path which
+	 * are already determined by the returned assignment. */
+	std::optional<klee::Assignment> findNewPath(size_t *pathLength = NULL);
 	ConcreteStore getStore(const klee::Assignment &assign);
+
+	/* Alternative to findNewPath where the query for a new path is
+	 * solved asynchronously, see Solver::solveSerialized. Removes the
+	 * next node from the frontier and returns its id together with the
+	 * serialized query. The node remains pending until finishPending
+	 * is invoked with the result, which returns false if the result
+	 * must not be used (unsat or path explored meanwhile). */
+	std::optional<std::pair<uint64_t, std::string>> takePending(void);
+	bool finishPending(uint64_t id, bool sat);
+
+	/* Don't negate the first length branches of subsequent paths,
+	 * e.g. because the alternatives are explored by a different
+	 * process. Applies to nodes added to the tree afterwards. */
+	void setExploredPrefix(size_t length);
+
+	/* Serialize the execution tree, e.g. to resume exploration later.
+	 * A tree must only be loaded before the first node is added. If
+	 * the input is invalid, load throws and the tree is unchanged. */
+	void save(std::ostream &out);
+	void load(std::istream &in);
 };
 
 class ExecutionContext {
@@ -245,8 +488,12 @@ public:
 	bool setupNewValues(Trace &trace);
 
 	std::shared_ptr<ConcolicValue> getSymbolicWord(std::string name);
-	std::shared_ptr<ConcolicValue> getSymbolicBytes(std::string name, size_t size);
 	std::shared_ptr<ConcolicValue> getSymbolicByte(std::string name);
+
+	/* Concatenation of size symbolic bytes, at most eight bytes
+	 * since concrete values are limited to 64 bit. Larger buffers
+	 * must be created using getSymbolicByte for each byte. */
+	std::shared_ptr<ConcolicValue> getSymbolicBytes(std::string name, size_t size);
 };
 
 class TestCase {
@@ -268,8 +515,8 @@ class TestCase {
 	};
 
 public:
-	static ConcreteStore fromFile(std::string name, std::ifstream &stream);
-	static void toFile(ConcreteStore store, std::ofstream &stream);
+	static ConcreteStore fromFile(std::string name, std::istream &stream);
+	static void toFile(ConcreteStore store, std::ostream &stream);
 };
 
 }; // namespace clover
@@ -58,3 +58,18 @@ intFromVector(std::vector<unsigned char> vector)
 
 	return intval;
 }
+
+ConcreteStore
+storeFromAssignment(const klee::Assignment &assign)
+{
+	ConcreteStore store;
+	for (auto const &b : assign.bindings) {
+		auto array = b.first;
+		auto value = b.second;
+
+		std::string name = array->getName();
+		store[name] = intFromVector(value);
+	}
+
+	return store;
+}
@@ -59,6 +59,7 @@ enum CoreSolverType {
   METASMT_SOLVER,
   DUMMY_SOLVER,
   Z3_SOLVER,
+  Z3_INCREMENTAL_SOLVER,
   NO_SOLVER
 };
 
@@ -47,6 +47,14 @@ Solver *createCoreSolver(CoreSolverType cst) {
 #else
     klee_message("Not compiled with Z3 support");
     return NULL;
+#endif
+  case Z3_INCREMENTAL_SOLVER:
+#ifdef ENABLE_Z3
+    klee_message("Using incremental Z3 solver backend");
+    return new Z3Solver(/*incremental=*/true);
+#else
+    klee_message("Not compiled with Z3 support");
+    return NULL;
 #endif
   case NO_SOLVER:
     klee_message("Invalid solver");
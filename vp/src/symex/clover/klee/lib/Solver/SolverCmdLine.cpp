@@ -195,7 +195,9 @@ cl::opt<CoreSolverType> CoreSolverToUse(
                clEnumValN(METASMT_SOLVER, "metasmt",
                           "metaSMT" METASMT_IS_DEFAULT_STR),
                clEnumValN(DUMMY_SOLVER, "dummy", "Dummy solver"),
-               clEnumValN(Z3_SOLVER, "z3", "Z3" Z3_IS_DEFAULT_STR)
+               clEnumValN(Z3_SOLVER, "z3", "Z3" Z3_IS_DEFAULT_STR),
+               clEnumValN(Z3_INCREMENTAL_SOLVER, "z3-incremental",
+                          "Z3, reusing constraints of the previous query")
                    KLEE_LLVM_CL_VAL_END),
     cl::init(DEFAULT_CORE_SOLVER), cl::cat(SolvingCat));
 
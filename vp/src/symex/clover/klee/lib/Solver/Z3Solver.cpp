@@ -63,6 +63,15 @@ private:
   // Parameter symbols
   ::Z3_symbol timeoutParamStrSymbol;
 
+  // Incremental mode: Solver reused across queries and the constraints
+  // asserted in it, each constraint is asserted in its own scope.
+  bool incremental;
+  ::Z3_solver incrementalSolver;
+  std::vector<ref<Expr> > assertedConstraints;
+
+  ::Z3_solver prepareSolver(const Query &);
+  void releaseSolver(::Z3_solver theSolver);
+
   bool internalRunSolver(const Query &,
                          const std::vector<const Array *> *objects,
                          std::vector<std::vector<unsigned char> > *values,
@@ -70,7 +79,7 @@ private:
   bool validateZ3Model(::Z3_solver &theSolver, ::Z3_model &theModel);
 
 public:
-  Z3SolverImpl();
+  Z3SolverImpl(bool _incremental = false);
   ~Z3SolverImpl();
 
   char *getConstraintLog(const Query &);
@@ -82,6 +91,8 @@ public:
       timeoutInMilliSeconds = UINT_MAX;
     Z3_params_set_uint(builder->ctx, solverParameters, timeoutParamStrSymbol,
                        timeoutInMilliSeconds);
+    if (incrementalSolver)
+      Z3_solver_set_params(builder->ctx, incrementalSolver, solverParameters);
   }
 
   bool computeTruth(const Query &, bool &isValid);
@@ -98,13 +109,14 @@ public:
   SolverRunStatus getOperationStatusCode();
 };
 
-Z3SolverImpl::Z3SolverImpl()
+Z3SolverImpl::Z3SolverImpl(bool _incremental)
     : builder(new Z3Builder(
           /*autoClearConstructCache=*/false,
           /*z3LogInteractionFileArg=*/Z3LogInteractionFile.size() > 0
               ? Z3LogInteractionFile.c_str()
               : NULL)),
-      runStatusCode(SOLVER_RUN_STATUS_FAILURE) {
+      runStatusCode(SOLVER_RUN_STATUS_FAILURE), incremental(_incremental),
+      incrementalSolver(NULL) {
   assert(builder && "unable to create Z3Builder");
   solverParameters = Z3_mk_params(builder->ctx);
   Z3_params_inc_ref(builder->ctx, solverParameters);
@@ -135,11 +147,14 @@ Z3SolverImpl::Z3SolverImpl()
 }
 
 Z3SolverImpl::~Z3SolverImpl() {
+  if (incrementalSolver)
+    Z3_solver_dec_ref(builder->ctx, incrementalSolver);
   Z3_params_dec_ref(builder->ctx, solverParameters);
   delete builder;
 }
 
-Z3Solver::Z3Solver() : Solver(new Z3SolverImpl()) {}
+Z3Solver::Z3Solver(bool incremental)
+    : Solver(new Z3SolverImpl(incremental)) {}
 
 char *Z3Solver::getConstraintLog(const Query &query) {
   return impl->getConstraintLog(query);
@@ -252,23 +267,13 @@ bool Z3SolverImpl::internalRunSolver(
     std::vector<std::vector<unsigned char> > *values, bool &hasSolution) {
 
   TimerStatIncrementer t(stats::queryTime);
-  // NOTE: Z3 will switch to using a slower solver internally if push/pop are
-  // used so for now it is likely that creating a new solver each time is the
-  // right way to go until Z3 changes its behaviour.
-  //
-  // TODO: Investigate using a custom tactic as described in
-  // https://github.com/klee/klee/issues/653
-  Z3_solver theSolver = Z3_mk_solver(builder->ctx);
-  Z3_solver_inc_ref(builder->ctx, theSolver);
-  Z3_solver_set_params(builder->ctx, theSolver, solverParameters);
+  Z3_solver theSolver = prepareSolver(query);
 
   runStatusCode = SOLVER_RUN_STATUS_FAILURE;
 
   ConstantArrayFinder constant_arrays_in_query;
-  for (auto const &constraint : query.constraints) {
-    Z3_solver_assert(builder->ctx, theSolver, builder->construct(constraint));
+  for (auto const &constraint : query.constraints)
     constant_arrays_in_query.visit(constraint);
-  }
   ++stats::queries;
   if (objects)
     ++stats::queryCounterexamples;
@@ -308,7 +313,7 @@ bool Z3SolverImpl::internalRunSolver(
   runStatusCode = handleSolverResponse(theSolver, satisfiable, objects, values,
                                        hasSolution);
 
-  Z3_solver_dec_ref(builder->ctx, theSolver);
+  releaseSolver(theSolver);
   // Clear the builder's cache to prevent memory usage exploding.
   // By using ``autoClearConstructCache=false`` and clearning now
   // we allow Z3_ast expressions to be shared from an entire
@@ -328,6 +333,68 @@ bool Z3SolverImpl::internalRunSolver(
   return false; // failed
 }
 
+// Returns a solver with all constraints of the query asserted. Assertions
+// specific to the query must be added afterwards and are removed again
+// by releaseSolver().
+::Z3_solver Z3SolverImpl::prepareSolver(const Query &query) {
+  if (!incremental) {
+    // NOTE: Z3 will switch to using a slower solver internally if push/pop
+    // are used so for now it is likely that creating a new solver each time
+    // is the right way to go until Z3 changes its behaviour.
+    //
+    // TODO: Investigate using a custom tactic as described in
+    // https://github.com/klee/klee/issues/653
+    Z3_solver theSolver = Z3_mk_solver(builder->ctx);
+    Z3_solver_inc_ref(builder->ctx, theSolver);
+    Z3_solver_set_params(builder->ctx, theSolver, solverParameters);
+
+    for (auto const &constraint : query.constraints)
+      Z3_solver_assert(builder->ctx, theSolver, builder->construct(constraint));
+    return theSolver;
+  }
+
+  if (!incrementalSolver) {
+    incrementalSolver = Z3_mk_solver(builder->ctx);
+    Z3_solver_inc_ref(builder->ctx, incrementalSolver);
+    Z3_solver_set_params(builder->ctx, incrementalSolver, solverParameters);
+  }
+
+  // Queries of a concolic explorer share the constraints of the path
+  // prefix, only the scopes of the differing suffix are replaced.
+  size_t common = 0;
+  auto it = query.constraints.begin(), ie = query.constraints.end();
+  for (; it != ie && common < assertedConstraints.size(); ++it, ++common) {
+    if (*it != assertedConstraints[common])
+      break;
+  }
+
+  unsigned numPop = assertedConstraints.size() - common;
+  if (numPop) {
+    Z3_solver_pop(builder->ctx, incrementalSolver, numPop);
+    assertedConstraints.resize(common);
+  }
+
+  for (; it != ie; ++it) {
+    Z3_solver_push(builder->ctx, incrementalSolver);
+    Z3_solver_assert(builder->ctx, incrementalSolver, builder->construct(*it));
+    assertedConstraints.push_back(*it);
+  }
+
+  // Scope for assertions specific to this query.
+  Z3_solver_push(builder->ctx, incrementalSolver);
+  return incrementalSolver;
+}
+
+void Z3SolverImpl::releaseSolver(::Z3_solver theSolver) {
+  if (!incremental) {
+    Z3_solver_dec_ref(builder->ctx, theSolver);
+    return;
+  }
+
+  assert(theSolver == incrementalSolver);
+  Z3_solver_pop(builder->ctx, incrementalSolver, 1);
+}
+
 SolverImpl::SolverRunStatus Z3SolverImpl::handleSolverResponse(
     ::Z3_solver theSolver, ::Z3_lbool satisfiable,
     const std::vector<const Array *> *objects,
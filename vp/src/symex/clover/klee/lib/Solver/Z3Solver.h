@@ -17,8 +17,11 @@ namespace klee {
 /// Z3Solver - A complete solver based on Z3
 class Z3Solver : public Solver {
 public:
-  /// Z3Solver - Construct a new Z3Solver.
-  Z3Solver();
+  /// Z3Solver - Construct a new Z3Solver. In incremental mode, a single Z3
+  /// solver is used for all queries. Constraints shared with the previous
+  /// query (a common prefix of the constraint set) remain asserted, only
+  /// the differing suffix is popped and pushed.
+  Z3Solver(bool incremental = false);
 
   /// Get the query in SMT-LIBv2 format.
   /// \return A C-style string. The caller is responsible for freeing this.
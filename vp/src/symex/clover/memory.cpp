@@ -1,3 +1,7 @@
+#include <assert.h>
+#include <string.h>
+
+#include <algorithm>
 #include <iostream>
 
 #include <clover/clover.h>
@@ -6,31 +10,152 @@ using namespace clover;
 ConcolicMemory::ConcolicMemory(Solver &_solver)
     : solver(_solver)
 {
-	return;
+	lastPageNum = 0;
+	lastPage = nullptr;
 }
 
 void
 ConcolicMemory::reset(void)
 {
-	data.clear();
+	pages.clear();
+	undo = std::nullopt;
+	lastPage = nullptr;
 }
 
-std::shared_ptr<ConcolicValue>
-ConcolicMemory::load(Addr addr, unsigned bytesize)
+void
+ConcolicMemory::save(void)
 {
-	std::shared_ptr<ConcolicValue> result = nullptr;
-	for (uint32_t off = 0; off < bytesize; off++) {
-		auto read_addr = addr + off;
+	for (auto &entry : pages)
+		entry.second->recorded = false;
+
+	undo = std::unordered_map<Addr, std::unique_ptr<Page>>();
+}
+
+void
+ConcolicMemory::restore(void)
+{
+	assert(undo.has_value() && "restore() requires a prior save()");
 
-		std::shared_ptr<ConcolicValue> byte;
-		if (data.count(read_addr)) {
-			byte = data.at(read_addr);
+	for (auto &entry : *undo) {
+		if (entry.second) {
+			pages[entry.first] = std::move(entry.second);
 		} else {
-			std::cerr << "WARNING: Uninitialized memory accessed at 0x"
-			          << std::hex << read_addr << " initializing with zero" << std::endl;
-			byte = solver.BVC(std::nullopt, (uint8_t)0);
+			pages.erase(entry.first);
 		}
+	}
+
+	undo->clear();
+	lastPage = nullptr;
+}
+
+ConcolicMemory::Page *
+ConcolicMemory::getPage(Addr addr)
+{
+	Addr num = addr >> PAGE_BITS;
+	if (lastPage && lastPageNum == num)
+		return lastPage;
+
+	auto it = pages.find(num);
+	if (it == pages.end())
+		return nullptr;
+
+	lastPageNum = num;
+	lastPage = it->second.get();
+	return lastPage;
+}
 
+/* Returns the page containing the given address for modification,
+ * the page is allocated if it does not exist yet. If save() has been
+ * called, the original content is recorded on the first modification. */
+ConcolicMemory::Page *
+ConcolicMemory::modifyPage(Addr addr)
+{
+	Addr num = addr >> PAGE_BITS;
+
+	Page *page = getPage(addr);
+	if (page && (!undo.has_value() || page->recorded))
+		return page;
+
+	if (page) {
+		(*undo)[num] = std::make_unique<Page>(*page);
+		page->recorded = true;
+		return page;
+	} else if (undo.has_value()) {
+		(*undo)[num] = nullptr;
+	}
+
+	auto newPage = std::make_unique<Page>();
+	newPage->recorded = undo.has_value();
+
+	lastPageNum = num;
+	lastPage = newPage.get();
+
+	pages[num] = std::move(newPage);
+	return lastPage;
+}
+
+bool
+ConcolicMemory::hasOverlay(Page *page, Addr addr, unsigned bytesize)
+{
+	if (page->overlay.empty())
+		return false;
+
+	for (unsigned i = 0; i < bytesize; i++) {
+		if (page->overlay.count((addr + i) & PAGE_MASK))
+			return true;
+	}
+
+	return false;
+}
+
+std::shared_ptr<ConcolicValue>
+ConcolicMemory::loadByte(Addr addr)
+{
+	Page *page = getPage(addr);
+	if (!page) {
+		std::cerr << "WARNING: Uninitialized memory accessed at 0x"
+		          << std::hex << addr << " initializing with zero" << std::endl;
+		return solver.BVC(std::nullopt, (uint8_t)0);
+	}
+
+	auto off = addr & PAGE_MASK;
+	if (!page->overlay.empty()) {
+		auto it = page->overlay.find(off);
+		if (it != page->overlay.end())
+			return it->second;
+	}
+
+	return solver.BVC(std::nullopt, page->concrete[off]);
+}
+
+void
+ConcolicMemory::storeByte(Addr addr, std::shared_ptr<ConcolicValue> byte)
+{
+	Page *page = modifyPage(addr);
+
+	auto off = addr & PAGE_MASK;
+	page->concrete[off] = solver.getValue<uint8_t>(byte->concrete);
+
+	if (byte->symbolic.has_value() || byte->is_tainted()) {
+		page->overlay[off] = byte;
+	} else if (!page->overlay.empty()) {
+		page->overlay.erase(off);
+	}
+}
+
+std::shared_ptr<ConcolicValue>
+ConcolicMemory::load(Addr addr, unsigned bytesize)
+{
+	auto off = addr & PAGE_MASK;
+
+	// Fast path: concrete bytes within a single page.
+	Page *page = getPage(addr);
+	if (page && off + bytesize <= PAGE_SIZE && !hasOverlay(page, addr, bytesize))
+		return solver.BVC(&page->concrete[off], bytesize);
+
+	std::shared_ptr<ConcolicValue> result = nullptr;
+	for (uint32_t i = 0; i < bytesize; i++) {
+		auto byte = loadByte(addr + i);
 		if (!result) {
 			result = byte;
 		} else {
@@ -51,13 +176,22 @@ ConcolicMemory::load(std::shared_ptr<ConcolicValue> addr, unsigned bytesize)
 void
 ConcolicMemory::store(Addr addr, std::shared_ptr<ConcolicValue> value, unsigned bytesize)
 {
+	if (!value->symbolic.has_value() && !value->is_tainted()) {
+		uint8_t buf[sizeof(uint64_t)];
+
+		assert(bytesize <= sizeof(buf));
+		solver.BVCToBytes(value, buf, bytesize);
+
+		storeConcrete(addr, buf, bytesize);
+		return;
+	}
+
 	if (value->getWidth() < bytesize * 8)
 		value = value->zext(bytesize * 8);
 
-	for (size_t off = 0; off < bytesize; off++) {
-		// Extract expression works on bit indicies, not bytes.
-		data[addr + off] = value->extract(off * 8, klee::Expr::Int8);
-	}
+	// Extract expression works on bit indicies, not bytes.
+	for (size_t off = 0; off < bytesize; off++)
+		storeByte(addr + off, value->extract(off * 8, klee::Expr::Int8));
 }
 
 void
@@ -66,3 +200,29 @@ ConcolicMemory::store(std::shared_ptr<ConcolicValue> addr, std::shared_ptr<Conco
 	auto base_addr = solver.getValue<ConcolicMemory::Addr>(addr->concrete);
 	return store(base_addr, value, bytesize);
 }
+
+void
+ConcolicMemory::storeConcrete(Addr addr, const uint8_t *buf, size_t size)
+{
+	while (size > 0) {
+		Page *page = modifyPage(addr);
+
+		auto off = addr & PAGE_MASK;
+		size_t n = std::min(size, PAGE_SIZE - off);
+
+		if (buf) {
+			memcpy(&page->concrete[off], buf, n);
+			buf += n;
+		} else {
+			memset(&page->concrete[off], 0, n);
+		}
+
+		if (!page->overlay.empty()) {
+			for (size_t i = 0; i < n; i++)
+				page->overlay.erase(off + i);
+		}
+
+		addr += n;
+		size -= n;
+	}
+}
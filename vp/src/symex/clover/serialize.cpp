@@ -0,0 +1,477 @@
+#include <assert.h>
+#include <stdint.h>
+
+#include <sstream>
+#include <stdexcept>
+
+#include <clover/clover.h>
+#include <llvm/ADT/APInt.h>
+
+#include "serialize.h"
+
+using namespace clover;
+
+enum {
+	TAG_END = 0,
+	TAG_ARRAY,
+	TAG_EXPR,
+};
+
+/* Unsigned LEB128, small values (e.g. ids) only require a single byte */
+void
+clover::writeUint(std::ostream &out, uint64_t value)
+{
+	do {
+		uint8_t byte = value & 0x7f;
+		value >>= 7;
+		if (value)
+			byte |= 0x80;
+		out.put(byte);
+	} while (value);
+}
+
+uint64_t
+clover::readUint(std::istream &in)
+{
+	uint64_t value = 0;
+	for (unsigned shift = 0; shift < 64; shift += 7) {
+		int byte = in.get();
+		if (byte == EOF)
+			throw std::runtime_error("unexpected end of serialized data");
+
+		value |= (uint64_t)(byte & 0x7f) << shift;
+		if (!(byte & 0x80))
+			return value;
+	}
+
+	throw std::runtime_error("invalid integer in serialized data");
+}
+
+static void
+writeString(std::ostream &out, const std::string &str)
+{
+	writeUint(out, str.size());
+	out.write(str.data(), str.size());
+}
+
+static std::string
+readString(std::istream &in)
+{
+	std::string str(readUint(in), '\0');
+	if (!in.read(str.data(), str.size()))
+		throw std::runtime_error("unexpected end of serialized data");
+	return str;
+}
+
+/* Update nodes of a read expression, oldest update first */
+static std::vector<const klee::UpdateNode *>
+getUpdates(const klee::ReadExpr *read)
+{
+	std::vector<const klee::UpdateNode *> updates;
+	for (auto un = read->updates.head.get(); un; un = un->next.get())
+		updates.insert(updates.begin(), un);
+	return updates;
+}
+
+ExprWriter::ExprWriter(std::ostream &_out)
+    : out(_out)
+{
+	return;
+}
+
+uint64_t
+ExprWriter::writeArray(const klee::Array *array)
+{
+	auto it = arrays.find(array);
+	if (it != arrays.end())
+		return it->second;
+
+	out.put(TAG_ARRAY);
+	writeString(out, array->name);
+	writeUint(out, array->size);
+	writeUint(out, array->domain);
+	writeUint(out, array->range);
+
+	writeUint(out, array->constantValues.size());
+	for (auto &value : array->constantValues)
+		writeUint(out, value->getZExtValue());
+
+	uint64_t id = arrays.size();
+	arrays[array] = id;
+	return id;
+}
+
+/* All operands of the expression must have been written before */
+void
+ExprWriter::writeExpr(const klee::ref<klee::Expr> &expr)
+{
+	uint64_t arrayId = 0;
+	if (auto read = dyn_cast<klee::ReadExpr>(expr))
+		arrayId = writeArray(read->updates.root);
+
+	out.put(TAG_EXPR);
+	out.put(expr->getKind());
+	writeUint(out, expr->getWidth());
+
+	switch (expr->getKind()) {
+	case klee::Expr::Constant: {
+		auto ce = cast<klee::ConstantExpr>(expr);
+		const llvm::APInt &value = ce->getAPValue();
+
+		writeUint(out, value.getNumWords());
+		for (unsigned i = 0; i < value.getNumWords(); i++)
+			writeUint(out, value.getRawData()[i]);
+	} break;
+	case klee::Expr::Read: {
+		auto read = cast<klee::ReadExpr>(expr.get());
+		writeUint(out, arrayId);
+		writeUint(out, exprs.at(read->index.get()));
+
+		auto updates = getUpdates(read);
+		writeUint(out, updates.size());
+		for (auto un : updates) {
+			writeUint(out, exprs.at(un->index.get()));
+			writeUint(out, exprs.at(un->value.get()));
+		}
+	} break;
+	case klee::Expr::Extract:
+		writeUint(out, exprs.at(expr->getKid(0).get()));
+		writeUint(out, cast<klee::ExtractExpr>(expr)->offset);
+		break;
+	default:
+		for (unsigned i = 0; i < expr->getNumKids(); i++)
+			writeUint(out, exprs.at(expr->getKid(i).get()));
+		break;
+	}
+
+	uint64_t id = exprs.size();
+	exprs[expr.get()] = id;
+	refs.push_back(expr);
+}
+
+uint64_t
+ExprWriter::write(const klee::ref<klee::Expr> &expr)
+{
+	/* Post-order traversal, second element is true if the
+	 * operands of the expression have already been pushed. */
+	std::vector<std::pair<klee::ref<klee::Expr>, bool>> stack;
+	stack.push_back(std::make_pair(expr, false));
+
+	while (!stack.empty()) {
+		auto elem = stack.back();
+		stack.pop_back();
+
+		klee::ref<klee::Expr> e = elem.first;
+		if (exprs.count(e.get()))
+			continue;
+
+		if (elem.second) {
+			writeExpr(e);
+			continue;
+		}
+
+		stack.push_back(std::make_pair(e, true));
+		for (unsigned i = 0; i < e->getNumKids(); i++)
+			stack.push_back(std::make_pair(e->getKid(i), false));
+
+		if (auto read = dyn_cast<klee::ReadExpr>(e)) {
+			for (auto un : getUpdates(read)) {
+				stack.push_back(std::make_pair(un->index, false));
+				stack.push_back(std::make_pair(un->value, false));
+			}
+		}
+	}
+
+	return exprs.at(expr.get());
+}
+
+void
+ExprWriter::end(void)
+{
+	out.put(TAG_END);
+}
+
+ExprReader::ExprReader(klee::ArrayCache &_cache)
+    : cache(_cache)
+{
+	return;
+}
+
+klee::ref<klee::Expr>
+ExprReader::expr(uint64_t id)
+{
+	if (id >= exprs.size())
+		throw std::runtime_error("invalid expression reference");
+	return exprs[id];
+}
+
+const klee::Array *
+ExprReader::array(uint64_t id)
+{
+	if (id >= arrays.size())
+		throw std::runtime_error("invalid array reference");
+	return arrays[id];
+}
+
+void
+ExprReader::read(std::istream &in)
+{
+	for (;;) {
+		int tag = in.get();
+		if (tag == EOF)
+			throw std::runtime_error("unexpected end of serialized data");
+
+		if (tag == TAG_END) {
+			return;
+		} else if (tag == TAG_ARRAY) {
+			std::string name = readString(in);
+			uint64_t size = readUint(in);
+			klee::Expr::Width domain = readUint(in);
+			klee::Expr::Width range = readUint(in);
+
+			std::vector<klee::ref<klee::ConstantExpr>> values;
+			uint64_t nvalues = readUint(in);
+			for (uint64_t i = 0; i < nvalues; i++)
+				values.push_back(klee::ConstantExpr::create(readUint(in), range));
+
+			const klee::Array *a;
+			if (values.empty())
+				a = cache.CreateArray(name, size, nullptr, nullptr, domain, range);
+			else
+				a = cache.CreateArray(name, size, &values[0], &values[0] + values.size(), domain, range);
+
+			arrays.push_back(a);
+			continue;
+		} else if (tag != TAG_EXPR) {
+			throw std::runtime_error("invalid tag in serialized data");
+		}
+
+		auto kind = (klee::Expr::Kind)in.get();
+		klee::Expr::Width width = readUint(in);
+
+		klee::ref<klee::Expr> e;
+		switch (kind) {
+		case klee::Expr::Constant: {
+			std::vector<uint64_t> words(readUint(in));
+			for (auto &word : words)
+				word = readUint(in);
+			e = klee::ConstantExpr::alloc(llvm::APInt(width, words));
+		} break;
+		case klee::Expr::Read: {
+			const klee::Array *root = array(readUint(in));
+			auto index = expr(readUint(in));
+
+			klee::UpdateList ul(root, nullptr);
+			uint64_t nupdates = readUint(in);
+			for (uint64_t i = 0; i < nupdates; i++) {
+				auto uindex = expr(readUint(in));
+				auto uvalue = expr(readUint(in));
+				ul.extend(uindex, uvalue);
+			}
+
+			e = klee::ReadExpr::create(ul, index);
+		} break;
+		case klee::Expr::Extract: {
+			auto kid = expr(readUint(in));
+			unsigned offset = readUint(in);
+			e = klee::ExtractExpr::create(kid, offset, width);
+		} break;
+		case klee::Expr::NotOptimized:
+			e = klee::NotOptimizedExpr::create(expr(readUint(in)));
+			break;
+		case klee::Expr::Not:
+			e = klee::NotExpr::create(expr(readUint(in)));
+			break;
+		case klee::Expr::ZExt:
+		case klee::Expr::SExt: {
+			std::vector<klee::Expr::CreateArg> args;
+			args.push_back(klee::Expr::CreateArg(expr(readUint(in))));
+			args.push_back(klee::Expr::CreateArg(width));
+			e = klee::Expr::createFromKind(kind, args);
+		} break;
+		default: {
+			unsigned nkids;
+			if (kind == klee::Expr::Select)
+				nkids = 3;
+			else if (kind == klee::Expr::Concat ||
+			         (kind >= klee::Expr::BinaryKindFirst && kind <= klee::Expr::BinaryKindLast))
+				nkids = 2;
+			else
+				throw std::runtime_error("invalid expression kind in serialized data");
+
+			std::vector<klee::Expr::CreateArg> args;
+			for (unsigned i = 0; i < nkids; i++)
+				args.push_back(klee::Expr::CreateArg(expr(readUint(in))));
+			e = klee::Expr::createFromKind(kind, args);
+		} break;
+		}
+
+		exprs.push_back(e);
+	}
+}
+
+klee::ref<klee::Expr>
+ExprReader::get(uint64_t id)
+{
+	return expr(id);
+}
+
+std::string
+clover::writeQuery(const klee::Query &query)
+{
+	std::ostringstream out, ids;
+	ExprWriter writer(out);
+
+	writeUint(ids, query.constraints.size());
+	for (auto &c : query.constraints)
+		writeUint(ids, writer.write(c));
+	writeUint(ids, writer.write(query.expr));
+	writer.end();
+
+	return out.str() + ids.str();
+}
+
+klee::ref<klee::Expr>
+clover::readQuery(std::istream &in, klee::ArrayCache &cache, klee::ConstraintSet &cs)
+{
+	ExprReader reader(cache);
+	reader.read(in);
+
+	uint64_t nconstraints = readUint(in);
+	for (uint64_t i = 0; i < nconstraints; i++)
+		cs.push_back(reader.get(readUint(in)));
+
+	return reader.get(readUint(in));
+}
+
+/* Tags of nodes in the serialized execution tree */
+enum {
+	NODE_NONE = 0,
+	NODE_PLACEHOLDER,
+	NODE_COLLAPSED,
+	NODE_BRANCH,
+};
+
+#define TREE_MAGIC "clover-tree"
+#define TREE_VERSION 1
+
+/* The tree is written in pre-order (true branch first), preceded by
+ * the expressions of all branch conditions. Nodes in the frontier
+ * are not stored explicitly, they are determined on load. */
+void
+Trace::save(std::ostream &out)
+{
+	std::ostringstream exprBuf, treeBuf;
+	ExprWriter writer(exprBuf);
+
+	std::vector<Branch *> stack;
+	stack.push_back(pathCondsRoot.get());
+	while (!stack.empty()) {
+		Branch *node = stack.back();
+		stack.pop_back();
+
+		if (!node) {
+			treeBuf.put(NODE_NONE);
+			continue;
+		} else if (node->collapsed) {
+			treeBuf.put(NODE_COLLAPSED);
+			continue;
+		} else if (node->isPlaceholder()) {
+			treeBuf.put(NODE_PLACEHOLDER);
+			continue;
+		}
+
+		/* The path of the last negated node and of pending nodes
+		 * might not have been executed yet, they are negated again
+		 * after loading. */
+		bool negated = node->wasNegated && node != lastNegated && !node->pending;
+
+		treeBuf.put(NODE_BRANCH);
+		treeBuf.put(negated | node->wasUnsat << 1);
+		writeUint(treeBuf, node->location);
+		writeUint(treeBuf, writer.write(node->bv->expr));
+
+		stack.push_back(node->false_branch.get());
+		stack.push_back(node->true_branch.get());
+	}
+	writer.end();
+
+	out.write(TREE_MAGIC, sizeof(TREE_MAGIC));
+	writeUint(out, TREE_VERSION);
+	out << exprBuf.str() << treeBuf.str();
+}
+
+void
+Trace::load(std::istream &in)
+{
+	assert(pathCondsRoot->isPlaceholder() && !pathCondsRoot->collapsed);
+	assert(frontier->empty());
+
+	char magic[sizeof(TREE_MAGIC)];
+	if (!in.read(magic, sizeof(magic)) || std::string(magic, sizeof(magic)) != std::string(TREE_MAGIC, sizeof(TREE_MAGIC)))
+		throw std::runtime_error("not a serialized execution tree");
+	if (readUint(in) != TREE_VERSION)
+		throw std::runtime_error("unsupported execution tree version");
+
+	ExprReader reader(solver.array_cache);
+	reader.read(in);
+
+	/* Each element refers to the slot of a node in its parent */
+	typedef std::pair<Branch *, std::shared_ptr<Branch> *> Slot;
+	std::vector<Slot> stack;
+	std::vector<Branch *> nodes;
+
+	std::shared_ptr<Branch> root;
+	stack.push_back(Slot(nullptr, &root));
+	while (!stack.empty()) {
+		Slot slot = stack.back();
+		stack.pop_back();
+
+		int tag = in.get();
+		switch (tag) {
+		case NODE_NONE:
+			*slot.second = nullptr;
+			continue;
+		case NODE_PLACEHOLDER:
+			*slot.second = std::make_shared<Branch>(slot.first);
+			continue;
+		case NODE_COLLAPSED:
+			*slot.second = std::make_shared<Branch>(slot.first);
+			(*slot.second)->collapsed = true;
+			continue;
+		case NODE_BRANCH:
+			break;
+		default:
+			throw std::runtime_error("invalid node in serialized execution tree");
+		}
+
+		auto node = std::make_shared<Branch>(slot.first);
+		int flags = in.get();
+		if (flags == EOF)
+			throw std::runtime_error("unexpected end of serialized data");
+		node->wasNegated = (flags & 1) != 0;
+		node->wasUnsat = (flags & 2) != 0;
+		node->location = readUint(in);
+		node->bv = std::make_shared<BitVector>(BitVector(reader.get(readUint(in))));
+		node->id = nextId++;
+		node->depth = (slot.first) ? slot.first->depth + 1 : 0;
+
+		*slot.second = node;
+		nodes.push_back(node.get());
+
+		stack.push_back(Slot(node.get(), &node->false_branch));
+		stack.push_back(Slot(node.get(), &node->true_branch));
+	}
+
+	pathCondsRoot = root;
+	pathCondsCurrent = nullptr;
+	lastNegated = nullptr;
+
+	/* Same condition as in add() */
+	for (auto node : nodes) {
+		if (!node->wasNegated && !(node->true_branch && node->false_branch)) {
+			node->unexplored = !node->true_branch;
+			addFrontier(node);
+		}
+	}
+}
@@ -0,0 +1,74 @@
+#ifndef CLOVER_SERIALIZE_H
+#define CLOVER_SERIALIZE_H
+
+#include <stdint.h>
+
+#include <iostream>
+#include <unordered_map>
+#include <vector>
+
+#include <klee/Expr/ArrayCache.h>
+#include <klee/Expr/Constraints.h>
+#include <klee/Expr/Expr.h>
+#include <klee/Solver/Solver.h>
+
+/* Binary encoding of KLEE expressions. Subexpressions and arrays are
+ * only encoded once, even if they are shared by multiple expressions.
+ * Expressions are encoded in post-order and without recursion, which
+ * allows encoding very deep expressions. The format is not portable. */
+
+namespace clover {
+
+class ExprWriter {
+private:
+	std::ostream &out;
+
+	std::unordered_map<const klee::Expr *, uint64_t> exprs;
+	std::unordered_map<const klee::Array *, uint64_t> arrays;
+
+	/* Keeps encoded expressions alive, ids are assigned by address */
+	std::vector<klee::ref<klee::Expr>> refs;
+
+	uint64_t writeArray(const klee::Array *array);
+	void writeExpr(const klee::ref<klee::Expr> &expr);
+
+public:
+	ExprWriter(std::ostream &_out);
+
+	/* Returns the id of the given expression, see ExprReader::get */
+	uint64_t write(const klee::ref<klee::Expr> &expr);
+
+	/* Must be invoked after all expressions have been written */
+	void end(void);
+};
+
+class ExprReader {
+private:
+	klee::ArrayCache &cache;
+
+	std::vector<klee::ref<klee::Expr>> exprs;
+	std::vector<const klee::Array *> arrays;
+
+	klee::ref<klee::Expr> expr(uint64_t id);
+	const klee::Array *array(uint64_t id);
+
+public:
+	/* Arrays are created using the given cache. Thus, they are
+	 * identical to the arrays of previously created expressions. */
+	ExprReader(klee::ArrayCache &_cache);
+
+	/* Reads all expressions written by an ExprWriter. */
+	void read(std::istream &in);
+	klee::ref<klee::Expr> get(uint64_t id);
+};
+
+void writeUint(std::ostream &out, uint64_t value);
+uint64_t readUint(std::istream &in);
+
+/* Encoding of a query, constraints are added to the given set */
+std::string writeQuery(const klee::Query &query);
+klee::ref<klee::Expr> readQuery(std::istream &in, klee::ArrayCache &cache, klee::ConstraintSet &cs);
+
+} // namespace clover
+
+#endif
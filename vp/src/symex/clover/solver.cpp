@@ -1,26 +1,39 @@
 #include <assert.h>
 #include <stdlib.h>
 
+#include <sstream>
+
 #include <clover/clover.h>
 
 #include <klee/Expr/Constraints.h>
 #include <klee/Expr/ExprUtil.h>
 
+#include "cache.h"
 #include "fns.h"
+#include "serialize.h"
 
 using namespace clover;
 
-Solver::Solver(klee::Solver *_solver)
+Solver::Solver(klee::Solver *_solver, std::optional<std::string> cacheDir, bool incremental)
 {
-	if (!_solver)
-		_solver = klee::createCoreSolver(klee::CoreSolverType::Z3_SOLVER);
+	if (!_solver) {
+		auto type = (incremental) ? klee::CoreSolverType::Z3_INCREMENTAL_SOLVER
+		                          : klee::CoreSolverType::Z3_SOLVER;
+		_solver = klee::createCoreSolver(type);
+	}
+	if (cacheDir.has_value())
+		_solver = createPersistentSolver(_solver, *cacheDir);
 
 	// Create fancy solver chain based on given core solver.
 	// Taken from lib/Solver/ConstructSolverChain.cpp
 	_solver = klee::createFastCexSolver(_solver);
 	_solver = klee::createCexCachingSolver(_solver);
 	_solver = klee::createCachingSolver(_solver);
-	_solver = klee::createIndependentSolver(_solver);
+
+	// Splitting constraints into independent sets reorders them, the
+	// incremental core solver relies on the order of the path instead.
+	if (!incremental)
+		_solver = klee::createIndependentSolver(_solver);
 
 	// Copied from tools/kleaver/main.cpp
 	builder = klee::createDefaultExprBuilder();
@@ -70,6 +83,20 @@ Solver::getAssignment(const klee::Query &query)
 	return klee::Assignment(objects, values);
 }
 
+std::optional<ConcreteStore>
+Solver::solveSerialized(const std::string &query)
+{
+	std::istringstream in(query);
+	klee::ConstraintSet cs;
+
+	auto expr = readQuery(in, array_cache, cs);
+	auto assign = getAssignment(klee::Query(cs, expr));
+	if (!assign.has_value())
+		return std::nullopt;
+
+	return storeFromAssignment(*assign);
+}
+
 bool
 Solver::eval(const klee::Query &query)
 {
@@ -94,7 +121,7 @@ Solver::eval(const klee::Query &query)
 std::shared_ptr<ConcolicValue>
 Solver::BVC(std::optional<std::string> name, IntValue value)
 {
-	auto concrete = std::make_shared<BitVector>(BitVector(value));
+	auto concrete = ConcreteValue(intToUint(value), intByteSize(value) * 8);
 	if (!name.has_value()) {
 		auto concolic = ConcolicValue(builder, false, concrete);
 		return std::make_shared<ConcolicValue>(concolic);
@@ -108,30 +135,42 @@ Solver::BVC(std::optional<std::string> name, IntValue value)
 }
 
 std::shared_ptr<ConcolicValue>
-Solver::BVC(uint8_t *buf, size_t buflen)
+Solver::BVConst(IntValue value)
 {
-	std::shared_ptr<ConcolicValue> result = nullptr;
-	for (size_t i = 0; i < buflen; i++) {
-		auto byte = BVC(std::nullopt, (uint8_t)buf[i]);
-		if (!result) {
-			result = byte;
-		} else {
-			result = byte->concat(result);
-		}
+	std::shared_ptr<ConcolicValue> *slot;
+	if (std::holds_alternative<uint8_t>(value)) {
+		slot = &consts8[std::get<uint8_t>(value)];
+	} else {
+		int32_t v = (int32_t)std::get<uint32_t>(value);
+		if (v < CONST_MIN || v > CONST_MAX)
+			return BVC(std::nullopt, value);
+		slot = &consts32[v - CONST_MIN];
 	}
 
-	return result;
+	if (!*slot)
+		*slot = BVC(std::nullopt, value);
+	return *slot;
+}
+
+std::shared_ptr<ConcolicValue>
+Solver::BVC(uint8_t *buf, size_t buflen)
+{
+	assert(buflen <= sizeof(uint64_t));
+
+	// Bytes are in little endian order, see BVCToBytes().
+	uint64_t value = 0;
+	for (size_t i = 0; i < buflen; i++)
+		value |= (uint64_t)buf[i] << (i * 8);
+
+	auto concolic = ConcolicValue(builder, false, ConcreteValue(value, buflen * 8));
+	return std::make_shared<ConcolicValue>(concolic);
 }
 
 void
 Solver::BVCToBytes(std::shared_ptr<ConcolicValue> value, uint8_t *buf, size_t buflen)
 {
-	if (value->getWidth() < buflen * 8)
-		value = value->zext(buflen * 8);
-
-	for (size_t i = 0; i < buflen; i++) {
-		// Extract expression works on bit indicies and bit sizes
-		auto byte = value->extract(i * 8, klee::Expr::Int8);
-		buf[i] = getValue<uint8_t>(byte->concrete);
-	}
+	// Bits above the width of the concrete value are zero.
+	uint64_t concrete = value->concrete.value;
+	for (size_t i = 0; i < buflen; i++)
+		buf[i] = (i < sizeof(concrete)) ? (uint8_t)(concrete >> (i * 8)) : 0;
 }
@@ -0,0 +1,219 @@
+#include <assert.h>
+#include <stdlib.h>
+
+#include <clover/clover.h>
+
+using namespace clover;
+
+std::unique_ptr<SearchStrategy>
+clover::newStrategy(std::string name, ScoreFunction score, std::function<uint64_t(void)> version)
+{
+	if (name == "dfs")
+		return std::make_unique<DepthFirstStrategy>();
+	else if (name == "bfs")
+		return std::make_unique<BreadthFirstStrategy>();
+	else if (name == "random")
+		return std::make_unique<RandomStrategy>();
+	else if (name == "guided")
+		return std::make_unique<GuidedStrategy>(score, version);
+
+	return nullptr;
+}
+
+void
+RandomStrategy::add(FrontierNode *node)
+{
+	assert(!indices.count(node));
+
+	indices[node] = nodes.size();
+	nodes.push_back(node);
+}
+
+void
+RandomStrategy::remove(FrontierNode *node)
+{
+	auto it = indices.find(node);
+	assert(it != indices.end());
+	size_t idx = it->second;
+	indices.erase(it);
+
+	/* Move last element into the free slot */
+	FrontierNode *last = nodes.back();
+	nodes.pop_back();
+	if (last != node) {
+		nodes[idx] = last;
+		indices[last] = idx;
+	}
+}
+
+bool
+RandomStrategy::empty(void)
+{
+	return nodes.empty();
+}
+
+FrontierNode *
+RandomStrategy::select(void)
+{
+	assert(!nodes.empty());
+
+	FrontierNode *node = nodes.at(rand() % nodes.size());
+	remove(node);
+	return node;
+}
+
+bool
+DepthFirstStrategy::Compare::operator()(const FrontierNode *a, const FrontierNode *b) const
+{
+	if (a->depth != b->depth)
+		return a->depth > b->depth;
+	return a->id > b->id;
+}
+
+void
+DepthFirstStrategy::add(FrontierNode *node)
+{
+	nodes.insert(node);
+}
+
+void
+DepthFirstStrategy::remove(FrontierNode *node)
+{
+	nodes.erase(node);
+}
+
+bool
+DepthFirstStrategy::empty(void)
+{
+	return nodes.empty();
+}
+
+FrontierNode *
+DepthFirstStrategy::select(void)
+{
+	assert(!nodes.empty());
+
+	FrontierNode *node = *nodes.begin();
+	nodes.erase(nodes.begin());
+	return node;
+}
+
+bool
+BreadthFirstStrategy::Compare::operator()(const FrontierNode *a, const FrontierNode *b) const
+{
+	if (a->depth != b->depth)
+		return a->depth < b->depth;
+	return a->id < b->id;
+}
+
+void
+BreadthFirstStrategy::add(FrontierNode *node)
+{
+	nodes.insert(node);
+}
+
+void
+BreadthFirstStrategy::remove(FrontierNode *node)
+{
+	nodes.erase(node);
+}
+
+bool
+BreadthFirstStrategy::empty(void)
+{
+	return nodes.empty();
+}
+
+FrontierNode *
+BreadthFirstStrategy::select(void)
+{
+	assert(!nodes.empty());
+
+	FrontierNode *node = *nodes.begin();
+	nodes.erase(nodes.begin());
+	return node;
+}
+
+GuidedStrategy::GuidedStrategy(ScoreFunction _score, std::function<uint64_t(void)> _version)
+    : score(_score), version(_version)
+{
+	assert(score);
+}
+
+bool
+GuidedStrategy::Compare::operator()(const Entry &a, const Entry &b) const
+{
+	if (a.first != b.first)
+		return a.first > b.first;
+	if (a.second->depth != b.second->depth)
+		return a.second->depth < b.second->depth;
+	return a.second->id < b.second->id;
+}
+
+uint64_t
+GuidedStrategy::getScore(FrontierNode *node)
+{
+	auto key = std::make_pair(node->location, node->unexplored);
+
+	auto it = scores.find(key);
+	if (it == scores.end())
+		it = scores.emplace(key, score(node->location, node->unexplored)).first;
+	return it->second;
+}
+
+/* Discards cached scores and reorders all nodes by their new score */
+void
+GuidedStrategy::rescore(void)
+{
+	scores.clear();
+	if (version)
+		scoredVersion = version();
+
+	std::vector<FrontierNode *> all;
+	for (auto &entry : nodes)
+		all.push_back(entry.second);
+
+	nodes.clear();
+	nodeScores.clear();
+	for (auto node : all)
+		add(node);
+}
+
+void
+GuidedStrategy::add(FrontierNode *node)
+{
+	assert(!nodeScores.count(node));
+
+	uint64_t s = getScore(node);
+	nodeScores[node] = s;
+	nodes.emplace(s, node);
+}
+
+void
+GuidedStrategy::remove(FrontierNode *node)
+{
+	auto it = nodeScores.find(node);
+	assert(it != nodeScores.end());
+
+	nodes.erase(std::make_pair(it->second, node));
+	nodeScores.erase(it);
+}
+
+bool
+GuidedStrategy::empty(void)
+{
+	return nodes.empty();
+}
+
+FrontierNode *
+GuidedStrategy::select(void)
+{
+	assert(!nodes.empty());
+
+	if (!version || version() != scoredVersion)
+		rescore();
+
+	FrontierNode *node = nodes.begin()->second;
+	remove(node);
+	return node;
+}
@@ -7,6 +7,7 @@
 #include <klee/Expr/ExprUtil.h>
 
 #include "fns.h"
+#include "serialize.h"
 
 using namespace clover;
 
@@ -15,17 +16,85 @@ Trace::Trace(Solver &_solver)
 {
 	pathCondsRoot = std::make_shared<Branch>(Branch()); /* placeholder */
 	pathCondsCurrent = nullptr;
+
+	pathDepth = 0;
+	exploredPrefix = 0;
+
+	frontier = std::make_unique<RandomStrategy>();
+	nextId = 0;
+	lastNegated = nullptr;
 }
 
 void
 Trace::reset(void)
 {
+	finishPath();
+
 	cs = klee::ConstraintSet();
 	pathCondsCurrent = nullptr;
+	pathDepth = 0;
+}
+
+void
+Trace::setStrategy(std::unique_ptr<SearchStrategy> strategy)
+{
+	assert(strategy && strategy->empty());
+	assert(frontier->empty());
+
+	frontier = std::move(strategy);
+}
+
+void
+Trace::addFrontier(Branch *node)
+{
+	if (node->inFrontier)
+		return;
+
+	node->inFrontier = true;
+	frontier->add(node);
+}
+
+void
+Trace::removeFrontier(Branch *node)
+{
+	if (!node->inFrontier)
+		return;
+
+	node->inFrontier = false;
+	frontier->remove(node);
+}
+
+void
+Trace::prune(Branch *node)
+{
+	while (node && node->isExhausted()) {
+		node->collapse();
+		node = node->parent;
+	}
+}
+
+void
+Trace::finishPath(void)
+{
+	auto leaf = pathCondsCurrent;
+	if (!leaf || !leaf->isPlaceholder() || leaf->collapsed)
+		return;
+
+	/* The leaf of the previous path has been fully explored */
+	leaf->collapse();
+	prune(leaf->parent);
+
+	pathCondsCurrent = nullptr;
+}
+
+void
+Trace::setExploredPrefix(size_t length)
+{
+	exploredPrefix = length;
 }
 
 void
-Trace::add(bool condition, std::shared_ptr<BitVector> bv)
+Trace::add(bool condition, std::shared_ptr<BitVector> bv, uint64_t location)
 {
 	auto c = (condition) ? bv->eqTrue() : bv->eqFalse();
 	cm.addConstraint(c->expr);
@@ -38,18 +107,34 @@ Trace::add(bool condition, std::shared_ptr<BitVector> bv)
 	}
 
 	assert(branch);
-	if (branch->isPlaceholder())
+	if (branch->collapsed)
+		return; /* path has been explored before, nothing to track */
+
+	if (branch->isPlaceholder()) {
 		branch->bv = bv;
+		branch->id = nextId++;
+		branch->depth = pathDepth;
+		branch->location = location;
+	}
+	if (pathDepth++ < exploredPrefix)
+		branch->wasNegated = true;
 
 	if (condition) {
 		if (!branch->true_branch)
-			branch->true_branch = std::make_shared<Branch>(Branch());
+			branch->true_branch = std::make_shared<Branch>(branch.get());
 		pathCondsCurrent = branch->true_branch;
 	} else {
 		if (!branch->false_branch)
-			branch->false_branch = std::make_shared<Branch>(Branch());
+			branch->false_branch = std::make_shared<Branch>(branch.get());
 		pathCondsCurrent = branch->false_branch;
 	}
+
+	if (branch->wasNegated || (branch->true_branch && branch->false_branch)) {
+		removeFrontier(branch.get());
+	} else {
+		branch->unexplored = !condition;
+		addFrontier(branch.get());
+	}
 }
 
 klee::Query
@@ -85,19 +170,37 @@ Trace::newQuery(klee::ConstraintSet &cs, Branch::Path &path)
 }
 
 std::optional<klee::Assignment>
-Trace::findNewPath(void)
+Trace::findNewPath(size_t *pathLength)
 {
 	std::optional<klee::Assignment> assign;
 
+	lastNegated = nullptr;
+	finishPath();
 	do {
 		klee::ConstraintSet cs;
 
-		Branch::Path path;
-		if (!pathCondsRoot->getRandomPath(path))
+		if (frontier->empty())
 			return std::nullopt; /* all branches exhausted */
 
+		Branch *node = static_cast<Branch *>(frontier->select());
+		node->inFrontier = false;
+		node->wasNegated = true;
+
+		Branch::Path path;
+		node->getPath(path);
+
 		auto query = newQuery(cs, path);
 		assign = solver.getAssignment(query);
+
+		if (!assign.has_value()) {
+			node->wasUnsat = true;
+			prune(node);
+		} else {
+			lastNegated = node;
+		}
+
+		if (pathLength)
+			*pathLength = path.size();
 	} while (!assign.has_value()); /* loop until we found a sat assignment */
 
 	assert(assign.has_value());
@@ -107,14 +210,51 @@ Trace::findNewPath(void)
 ConcreteStore
 Trace::getStore(const klee::Assignment &assign)
 {
-	ConcreteStore store;
-	for (auto const &b : assign.bindings) {
-		auto array = b.first;
-		auto value = b.second;
+	return storeFromAssignment(assign);
+}
 
-		std::string name = array->getName();
-		store[name] = intFromVector(value);
-	}
+std::optional<std::pair<uint64_t, std::string>>
+Trace::takePending(void)
+{
+	finishPath();
+	if (frontier->empty())
+		return std::nullopt;
+
+	Branch *node = static_cast<Branch *>(frontier->select());
+	node->inFrontier = false;
+	node->wasNegated = true;
+	node->pending = true;
+	pending[node->id] = node;
+
+	Branch::Path path;
+	node->getPath(path);
+
+	klee::ConstraintSet cs;
+	auto query = newQuery(cs, path);
+	return std::make_pair(node->id, writeQuery(query));
+}
+
+bool
+Trace::finishPending(uint64_t id, bool sat)
+{
+	auto it = pending.find(id);
+	assert(it != pending.end());
+	Branch *node = it->second;
+	pending.erase(it);
+
+	/* Pending nodes are never collapsed, see isExhausted */
+	node->pending = false;
+	if (!sat)
+		node->wasUnsat = true;
+
+	/* The negated branch may have been taken by a path resulting
+	 * from the negation of a different node in the meantime. */
+	bool explored = node->true_branch && node->false_branch;
+	prune(node);
+
+	if (!sat || explored)
+		return false;
 
-	return store;
+	lastNegated = node;
+	return true;
 }
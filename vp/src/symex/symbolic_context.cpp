@@ -20,6 +20,9 @@
 #include "symbolic_context.h"
 
 #define TIMEOUT_ENV "SYMEX_TIMEOUT"
+#define STRATEGY_ENV "SYMEX_STRATEGY"
+#define SOLVER_CACHE_ENV "SYMEX_SOLVER_CACHE"
+#define SOLVER_INCREMENTAL_ENV "SYMEX_SOLVER_INCREMENTAL"
 
 // We need to pass the SymbolicContext which includes the solver,
 // tracer, … to the sc_main method somehow. This cannot be done using
@@ -27,14 +30,51 @@
 // instead.
 SymbolicContext symbolic_context = SymbolicContext();
 
+// Directory in which solver results are cached across runs.
+static std::optional<std::string>
+solver_cache_dir(void)
+{
+	char *dir = getenv(SOLVER_CACHE_ENV);
+	if (!dir)
+		return std::nullopt;
+	return std::string(dir);
+}
+
 SymbolicContext::SymbolicContext(void)
-	: solver(), trace(solver), ctx(solver)
+	: solver(nullptr, solver_cache_dir(), getenv(SOLVER_INCREMENTAL_ENV) != nullptr),
+	  trace(solver), ctx(solver)
 {
-	char *tm;
+	char *tm, *st;
 
 	this->user_data = nullptr;
 	if ((tm = getenv(TIMEOUT_ENV))) {
 		auto timeout = klee::time::Span(tm);
 		solver.setTimeout(timeout);
 	}
+
+	// Validated by setup_strategy, exceptions thrown during static
+	// initialization cannot be reported properly.
+	if ((st = getenv(STRATEGY_ENV)))
+		strategy = std::string(st);
+}
+
+bool
+SymbolicContext::setup_strategy(void)
+{
+	if (!strategy.has_value())
+		return true; // use the default strategy of the trace
+
+	auto score = [this](uint64_t location, bool taken) -> uint64_t {
+		return (location_score) ? location_score(location, taken) : 0;
+	};
+	auto version = [this](void) -> uint64_t {
+		return (score_version) ? score_version() : 0;
+	};
+
+	auto s = clover::newStrategy(*strategy, score, version);
+	if (!s)
+		return false;
+
+	trace.setStrategy(std::move(s));
+	return true;
 }
@@ -18,9 +18,15 @@
 #ifndef RISCV_ISA_SYMBOLIC_CTX_H
 #define RISCV_ISA_SYMBOLIC_CTX_H
 
+#include <stddef.h>
 #include <stdint.h>
 #include <stdbool.h>
 
+#include <functional>
+#include <iostream>
+#include <optional>
+#include <string>
+
 #include <clover/clover.h>
 
 class SymbolicContext {
@@ -30,7 +36,34 @@ public:
 	clover::ExecutionContext ctx;
 	void *user_data;
 
+	// Optional, used to combine the user_data of different worker
+	// processes when exploring paths in parallel (see SYMEX_JOBS).
+	std::function<void(std::ostream &)> dump_user_data;
+	std::function<void(std::istream &)> merge_user_data;
+
+	// Optional, scores the unexplored direction of branches for the
+	// guided search strategy (see SYMEX_STRATEGY). Higher scores are
+	// preferred. Scores are cached until score_version changes.
+	std::function<uint64_t(uint64_t, bool)> location_score;
+	std::function<uint64_t(void)> score_version;
+
+	// Optional, invoked before a new path is executed. The amount
+	// of new coverage (e.g. edges) found by the current path is
+	// returned by new_coverage, for prioritizing or pruning paths.
+	std::function<void(void)> begin_path;
+	std::function<size_t(void)> new_coverage;
+
+	// Optional, writes a checkpoint of the user_data to the given file
+	// (see SYMEX_CHECKPOINT). Blocks until it has been written if the
+	// second argument is true, otherwise it is written asynchronously.
+	std::function<void(const std::string &, bool)> checkpoint;
+
+	// Name of the search strategy (see SYMEX_STRATEGY), applied to
+	// the trace by setup_strategy which returns false if unknown.
+	std::optional<std::string> strategy;
+
 	SymbolicContext(void);
+	bool setup_strategy(void);
 };
 
 extern SymbolicContext symbolic_context;
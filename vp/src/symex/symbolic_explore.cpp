@@ -39,13 +39,177 @@
 #include <clover/clover.h>
 #include "symbolic_explore.h"
 #include "symbolic_context.h"
+#include "symbolic_parallel.h"
 
 #define TESTCASE_ENV "SYMEX_TESTCASE"
 #define TIMEBUDGET_ENV "SYMEX_TIMEBUDGET"
 #define ERR_EXIT_ENV "SYMEX_ERREXIT"
+#define SNAPSHOT_ENV "SYMEX_SNAPSHOT"
+#define JOBS_ENV "SYMEX_JOBS"
+#define SOLVERS_ENV "SYMEX_SOLVERS"
+#define CHECKPOINT_ENV "SYMEX_CHECKPOINT"
+#define CHECKPOINT_PATHS_ENV "SYMEX_CHECKPOINT_PATHS"
+#define CHECKPOINT_INTERVAL_ENV "SYMEX_CHECKPOINT_INTERVAL"
+#define RESUME_ENV "SYMEX_RESUME"
+
+// Interval between checkpoints if neither the amount of paths
+// nor the time interval has been configured explicitly.
+#define DEFAULT_CHECKPOINT_INTERVAL 60 /* seconds */
+
+typedef std::chrono::high_resolution_clock::time_point time_point;
 
 static std::filesystem::path *testcase_path = nullptr;
+static pid_t testcase_owner;
 static size_t errors_found = 0;
+static size_t paths_found = 0;
+static std::optional<time_point> budget;
+
+static bool snapshot_mode = false;
+static std::vector<snapshot_if *> snapshot_components;
+
+// Identifier of this worker process, negative if paths
+// are not explored in parallel (see SYMEX_JOBS).
+static int worker_id = -1;
+
+// Whether new paths are determined by solver processes while the
+// current path is executed (see SYMEX_SOLVERS).
+static bool pipelined = false;
+
+// A checkpoint is written after the given amount of paths or
+// seconds, whatever comes first. Zero disables the criterion.
+static size_t checkpoint_paths = 0;
+static std::chrono::seconds checkpoint_interval(0);
+static size_t last_checkpoint_paths = 0;
+static time_point last_checkpoint;
+
+std::optional<std::string>
+symbolic_checkpoint_file(void)
+{
+	char *path = getenv(CHECKPOINT_ENV);
+	if (!path || getenv(TESTCASE_ENV))
+		return std::nullopt;
+
+	// Each worker checkpoints its own coverage information.
+	std::string fp(path);
+	if (worker_id >= 0)
+		fp += "-worker" + std::to_string(worker_id);
+	return fp;
+}
+
+bool
+symbolic_resume_enabled(void)
+{
+	return getenv(RESUME_ENV) != nullptr;
+}
+
+// Workers explore subtrees assigned by the coordinator process (see
+// SYMEX_JOBS), the execution tree is only persisted without workers.
+static std::optional<std::string>
+trace_file(void)
+{
+	auto fp = symbolic_checkpoint_file();
+	if (!fp.has_value() || worker_id >= 0)
+		return std::nullopt;
+	return *fp + ".tree";
+}
+
+static void
+save_trace(void)
+{
+	auto fp = trace_file();
+	if (!fp.has_value())
+		return;
+
+	// Write to a temporary file first, a checkpoint must never
+	// be left incomplete if the process is terminated meanwhile.
+	std::string tmp = *fp + ".tmp";
+	try {
+		std::ofstream file(tmp, std::ios::binary);
+		if (!file.is_open())
+			throw std::runtime_error("failed to open " + tmp);
+		symbolic_context.trace.save(file);
+
+		file.close();
+		if (!file)
+			throw std::runtime_error("failed to write " + tmp);
+		std::filesystem::rename(tmp, *fp);
+	} catch (const std::exception &e) {
+		std::cerr << "WARNING: Failed to write execution tree: " << e.what() << std::endl;
+	}
+}
+
+// Returns false if the loaded execution tree has been fully explored.
+static bool
+load_trace(void)
+{
+	auto fp = trace_file();
+	if (!fp.has_value())
+		return true;
+
+	std::ifstream file(*fp, std::ios::binary);
+	if (!file.is_open()) {
+		std::cerr << "WARNING: No execution tree at " << *fp << std::endl;
+		return true;
+	}
+
+	clover::ExecutionContext &ctx = symbolic_context.ctx;
+	clover::Trace &tracer = symbolic_context.trace;
+
+	// The trace is left unmodified if loading fails, exploration
+	// then starts from scratch (same as without an execution tree).
+	try {
+		tracer.load(file);
+	} catch (const std::exception &e) {
+		std::cerr << "WARNING: Ignoring invalid execution tree " << *fp << ": " << e.what() << std::endl;
+		return true;
+	}
+
+	return ctx.setupNewValues(tracer);
+}
+
+static void
+write_checkpoint(bool wait)
+{
+	auto fp = symbolic_checkpoint_file();
+	if (!fp.has_value())
+		return;
+
+	if (symbolic_context.checkpoint)
+		symbolic_context.checkpoint(*fp, wait);
+	save_trace();
+
+	last_checkpoint_paths = paths_found;
+	last_checkpoint = std::chrono::high_resolution_clock::now();
+}
+
+static void
+checkpoint_if_due(void)
+{
+	if (checkpoint_paths && paths_found - last_checkpoint_paths >= checkpoint_paths) {
+		write_checkpoint(false);
+		return;
+	}
+
+	auto now = std::chrono::high_resolution_clock::now();
+	if (checkpoint_interval.count() && now - last_checkpoint >= checkpoint_interval)
+		write_checkpoint(false);
+}
+
+static void
+setup_checkpoints(void)
+{
+	char *paths = getenv(CHECKPOINT_PATHS_ENV);
+	if (paths)
+		checkpoint_paths = std::atoi(paths);
+
+	char *interval = getenv(CHECKPOINT_INTERVAL_ENV);
+	if (interval)
+		checkpoint_interval = std::chrono::seconds(std::atoi(interval));
+
+	if (!paths && !interval)
+		checkpoint_interval = std::chrono::seconds(DEFAULT_CHECKPOINT_INTERVAL);
+	last_checkpoint = std::chrono::high_resolution_clock::now();
+}
 
 static std::optional<std::string>
 dump_input(std::string fn)
@@ -75,13 +239,18 @@ report_handler(const sc_core::sc_report& report, const sc_core::sc_actions& acti
 		return;
 	}
 
-	auto path = dump_input("error" + std::to_string(++errors_found));
+	auto fn = "error" + std::to_string(++errors_found);
+	if (worker_id >= 0)
+		fn += "-worker" + std::to_string(worker_id);
+
+	auto path = dump_input(fn);
 	if (!path.has_value())
 		return;
 
 	if (getenv(ERR_EXIT_ENV)) {
 		std::cerr << "Found error, use " << *path << " to reproduce." << std::endl;
 		std::cerr << "Exit on first error set, terminating..." << std::endl;
+		write_checkpoint(true);
 		exit(EXIT_FAILURE);
 	}
 }
@@ -90,7 +259,7 @@ static void
 remove_testdir(void)
 {
 	assert(testcase_path != nullptr);
-	if (errors_found > 0)
+	if (errors_found > 0 || getpid() != testcase_owner)
 		return;
 
 	// Remove test directory if no errors were found
@@ -110,6 +279,7 @@ create_testdir(void)
 	if (!(dirpath = mkdtemp(tmpl)))
 		throw std::system_error(errno, std::generic_category());
 	testcase_path = new std::filesystem::path(dirpath);
+	testcase_owner = getpid();
 
 	if (std::atexit(remove_testdir))
 		throw std::runtime_error("std::atexit failed");
@@ -130,36 +300,108 @@ run_test(const char *path, int argc, char **argv)
 	return sc_core::sc_elab_and_sim(argc, argv);
 }
 
-static size_t
-explore_paths(int argc, char **argv)
+static bool
+budget_exceeded(void)
+{
+	if (!budget.has_value())
+		return false;
+
+	time_point now = std::chrono::high_resolution_clock::now();
+	if (now >= budget) {
+		std::cout << "Time budget exceeded, terminating..." << std::endl;
+		return true;
+	}
+
+	return false;
+}
+
+static void
+begin_path(void)
+{
+	if (paths_found > 0)
+		checkpoint_if_due();
+
+	std::cout << std::endl << "##" << std::endl << "# "
+		<< ++paths_found << "th concolic execution" << std::endl
+		<< "##" << std::endl;
+
+	symbolic_context.trace.reset();
+	if (symbolic_context.begin_path)
+		symbolic_context.begin_path();
+}
+
+bool
+symbolic_snapshot_enabled(void)
+{
+	return snapshot_mode;
+}
+
+void
+symbolic_snapshot_register(snapshot_if *component)
+{
+	snapshot_components.push_back(component);
+}
+
+void
+symbolic_snapshot_save(void)
+{
+	for (auto component : snapshot_components)
+		component->save_state();
+}
+
+static bool
+setup_next_path(void)
 {
 	clover::ExecutionContext &ctx = symbolic_context.ctx;
 	clover::Trace &tracer = symbolic_context.trace;
 
-	typedef std::chrono::high_resolution_clock::time_point time_point;
-	std::optional<time_point> budget;
+	if (worker_id >= 0)
+		return parallel_next_path(ctx, tracer);
+	else if (pipelined)
+		return pipeline_next_path(ctx, tracer);
+	return ctx.setupNewValues(tracer);
+}
 
-	char *timebudget = getenv(TIMEBUDGET_ENV);
-	if (timebudget) {
-		budget = std::chrono::high_resolution_clock::now() +
-			std::chrono::seconds(std::atoi(timebudget));
-	}
+bool
+symbolic_next_path(void)
+{
+	if (!setup_next_path() || budget_exceeded())
+		return false;
 
-	size_t paths_found = 0;
-	do {
-		if (budget.has_value()) {
-			time_point now = std::chrono::high_resolution_clock::now();
-			if (now >= budget) {
-				std::cout << "Time budget exceeded, terminating..." << std::endl;
-				break;
-			}
-		}
+	begin_path();
+	for (auto component : snapshot_components)
+		component->restore_state();
 
-		std::cout << std::endl << "##" << std::endl << "# "
-			<< ++paths_found << "th concolic execution" << std::endl
-			<< "##" << std::endl;
+	return true;
+}
+
+// Elaborates the platform once, all paths are then executed within
+// the same simulation context through symbolic_next_path().
+static size_t
+explore_paths_snapshot(int argc, char **argv)
+{
+	if (budget_exceeded())
+		return paths_found;
+	begin_path();
+
+	int ret;
+	if ((ret = sc_core::sc_elab_and_sim(argc, argv)))
+		return ret;
+	snapshot_components.clear();
 
-		tracer.reset();
+	sc_core::sc_report_handler::release();
+	delete sc_core::sc_curr_simcontext;
+
+	return paths_found;
+}
+
+static size_t
+explore_paths(int argc, char **argv)
+{
+	do {
+		if (budget_exceeded())
+			break;
+		begin_path();
 
 		// Reset SystemC simulation context
 		// See also: https://github.com/accellera-official/systemc/issues/8
@@ -172,7 +414,7 @@ explore_paths(int argc, char **argv)
 		int ret;
 		if ((ret = sc_core::sc_elab_and_sim(argc, argv)))
 			return ret;
-	} while (ctx.setupNewValues(tracer));
+	} while (setup_next_path());
 
 	sc_core::sc_report_handler::release();
 	delete sc_core::sc_curr_simcontext;
@@ -180,6 +422,94 @@ explore_paths(int argc, char **argv)
 	return paths_found;
 }
 
+static std::filesystem::path
+worker_data(int id)
+{
+	assert(testcase_path);
+	return *testcase_path / ("coverage-worker" + std::to_string(id));
+}
+
+// Invoked in each worker process. Worker 0 is terminated last and
+// merges the user data of all other workers, it is the only worker
+// which returns from this function, all other workers exit.
+static void
+explore_worker(int argc, char **argv, unsigned jobs)
+{
+	clover::ExecutionContext &ctx = symbolic_context.ctx;
+	clover::Trace &tracer = symbolic_context.trace;
+
+	// Random state is otherwise shared with all other workers.
+	std::srand(std::time(nullptr) ^ getpid());
+
+	if (parallel_next_path(ctx, tracer)) {
+		if (snapshot_mode) {
+			explore_paths_snapshot(argc, argv);
+		} else {
+			explore_paths(argc, argv);
+		}
+	}
+	parallel_wait();
+
+	ParallelStats stats;
+	stats.paths = paths_found;
+	stats.errors = errors_found;
+
+	if (worker_id != 0) {
+		if (symbolic_context.dump_user_data) {
+			std::ofstream file(worker_data(worker_id), std::ios::binary);
+			symbolic_context.dump_user_data(file);
+		}
+
+		parallel_report(stats);
+		exit(EXIT_SUCCESS);
+	}
+
+	for (unsigned i = 1; i < jobs; i++) {
+		auto path = worker_data(i);
+
+		std::ifstream file(path, std::ios::binary);
+		if (!file.is_open())
+			continue; /* worker did not execute any path */
+		if (symbolic_context.merge_user_data)
+			symbolic_context.merge_user_data(file);
+
+		std::filesystem::remove(path);
+	}
+
+	parallel_report(stats);
+}
+
+static int
+explore_parallel(int argc, char **argv, unsigned jobs)
+{
+	std::cout << std::flush;
+	if ((worker_id = parallel_fork(jobs)) >= 0) {
+		explore_worker(argc, argv, jobs);
+		return 0;
+	}
+
+	ParallelStats stats;
+	bool success = parallel_coordinate(budget_exceeded, stats);
+	errors_found = stats.errors;
+
+	if (!success) {
+		// Retain the testcase directory, it may contain
+		// errors found by the terminated worker.
+		errors_found++;
+		std::cerr << "Worker terminated unexpectedly, see "
+			<< *testcase_path << std::endl;
+	}
+
+	std::cout << std::endl << "---" << std::endl;
+	std::cout << "Unique paths found: " << stats.paths << std::endl;
+	if (stats.errors > 0) {
+		std::cout << "Errors found: " << stats.errors << std::endl;
+		std::cout << "Testcase directory: " << *testcase_path << std::endl;
+	}
+
+	return (success) ? 0 : EXIT_FAILURE;
+}
+
 int
 symbolic_explore(int argc, char **argv)
 {
@@ -200,10 +530,49 @@ symbolic_explore(int argc, char **argv)
 	// Set report handler for detecting errors
 	sc_core::sc_report_handler::set_handler(report_handler);
 
-	size_t paths_found = explore_paths(argc, argv);
+	char *timebudget = getenv(TIMEBUDGET_ENV);
+	if (timebudget) {
+		budget = std::chrono::high_resolution_clock::now() +
+			std::chrono::seconds(std::atoi(timebudget));
+	}
+
+	snapshot_mode = getenv(SNAPSHOT_ENV);
+	setup_checkpoints();
+
+	if (!symbolic_context.setup_strategy()) {
+		std::cerr << "Unknown search strategy: " << *symbolic_context.strategy << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	char *jobs = getenv(JOBS_ENV);
+	if (jobs && std::atoi(jobs) > 1)
+		return explore_parallel(argc, argv, (unsigned)std::atoi(jobs));
+
+	// Continue with the next unexplored path of a previous run.
+	if (symbolic_resume_enabled() && !load_trace()) {
+		std::cout << "All paths have already been explored." << std::endl;
+		return 0;
+	}
+
+	char *solvers = getenv(SOLVERS_ENV);
+	if (solvers && std::atoi(solvers) > 0) {
+		std::cout << std::flush;
+		pipeline_fork(symbolic_context.solver, (unsigned)std::atoi(solvers));
+		pipelined = true;
+	}
+
+	size_t paths;
+	if (snapshot_mode) {
+		paths = explore_paths_snapshot(argc, argv);
+	} else {
+		paths = explore_paths(argc, argv);
+	}
+	if (pipelined)
+		pipeline_stop();
+	write_checkpoint(true);
 
 	std::cout << std::endl << "---" << std::endl;
-	std::cout << "Unique paths found: " << paths_found << std::endl;
+	std::cout << "Unique paths found: " << paths << std::endl;
 	if (errors_found > 0) {
 		std::cout << "Errors found: " << errors_found << std::endl;
 		std::cout << "Testcase directory: " << *testcase_path << std::endl;
@@ -18,6 +18,31 @@
 #ifndef RISCV_ISA_SYMBOLIC_EXPLORE_H
 #define RISCV_ISA_SYMBOLIC_EXPLORE_H
 
+#include <optional>
+#include <string>
+
+#include "snapshot_if.h"
+
 int symbolic_explore(int argc, char **argv);
 
+// In snapshot mode (see SYMEX_SNAPSHOT) the platform is only elaborated
+// once. Registered components are saved after the executable has been
+// loaded and restored before a new path is executed.
+bool symbolic_snapshot_enabled(void);
+void symbolic_snapshot_register(snapshot_if *component);
+void symbolic_snapshot_save(void);
+
+// Invoked by the core runner once a path terminated in snapshot mode.
+// Returns false if there are no further paths to explore.
+bool symbolic_next_path(void);
+
+// Checkpoints of the user data are written periodically to the file
+// returned by this function (see SYMEX_CHECKPOINT), std::nullopt if
+// checkpoints are disabled. If symbolic_resume_enabled() returns true,
+// the user data should be restored from this file before exploration.
+// Without parallel workers, the execution tree is checkpointed to the
+// same path with a .tree suffix and exploration resumes from it.
+std::optional<std::string> symbolic_checkpoint_file(void);
+bool symbolic_resume_enabled(void);
+
 #endif
@@ -27,26 +27,42 @@ SymbolicMemory::SymbolicMemory(sc_core::sc_module_name, clover::Solver &_solver,
 void
 SymbolicMemory::load_data(const char *src, uint64_t dst_addr, size_t n)
 {
-	for (size_t i = 0; i < n; i++) {
-		auto byte = solver.BVC(std::nullopt, (uint8_t)src[i]);
-		memory.store(dst_addr + i, byte, 1);
-	}
+	memory.storeConcrete(dst_addr, (const uint8_t *)src, n);
 }
 
 void
 SymbolicMemory::load_zero(uint64_t dst_addr, size_t n)
 {
-	auto zero = solver.BVC(std::nullopt, (uint8_t)0);
-	for (size_t i = 0; i < n; i++)
-		memory.store(dst_addr + i, zero, 1);
+	memory.storeConcrete(dst_addr, NULL, n);
+}
+
+void
+SymbolicMemory::save_state(void)
+{
+	memory.save();
+}
+
+void
+SymbolicMemory::restore_state(void)
+{
+	memory.restore();
 }
 
 unsigned
 SymbolicMemory::read_data(tlm::tlm_generic_payload &trans)
 {
 	auto size = trans.get_data_length();
+	auto addr = trans.get_address();
+
+	// Concolic values are limited to 64 bit. Larger transactions
+	// (e.g. by the debugger) are performed on single bytes instead.
+	if (size > sizeof(uint64_t)) {
+		for (size_t i = 0; i < size; i++)
+			solver.BVCToBytes(memory.load(addr + i, 1), trans.get_data_ptr() + i, 1);
+		return size;
+	}
 
-	auto data = memory.load(trans.get_address(), size);
+	auto data = memory.load(addr, size);
 	SymbolicExtension *extension = new SymbolicExtension(data);
 
 	solver.BVCToBytes(data, trans.get_data_ptr(), trans.get_data_length());
@@ -64,10 +80,15 @@ SymbolicMemory::write_data(tlm::tlm_generic_payload &trans)
 	SymbolicExtension *extension;
 	trans.get_extension(extension);
 
-	if (extension)
+	if (extension) {
 		value = extension->getValue();
-	else
+	} else if (size > sizeof(uint64_t)) {
+		// See comment in SymbolicMemory::read_data
+		load_data((char *)trans.get_data_ptr(), trans.get_address(), size);
+		return size;
+	} else {
 		value = solver.BVC(trans.get_data_ptr(), size);
+	}
 
 	// ConcolicValue may have getWith() > size * 8, however,
 	// the ConcolicMemory::store will only store size bytes.
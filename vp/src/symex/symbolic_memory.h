@@ -23,13 +23,14 @@
 #include <clover/clover.h>
 #include <tlm_utils/simple_target_socket.h>
 #include <load_if.h>
+#include <snapshot_if.h>
 
 #include <systemc>
 #include <memory>
 
 #include "symbolic_extension.h"
 
-class SymbolicMemory : public sc_core::sc_module, public load_if {
+class SymbolicMemory : public sc_core::sc_module, public load_if, public snapshot_if {
 private:
 	clover::Solver &solver;
 	size_t size;
@@ -45,6 +46,9 @@ public:
 	void load_data(const char *src, uint64_t dst_addr, size_t n) override;
 	void load_zero(uint64_t dst_addr, size_t n) override;
 
+	void save_state(void) override;
+	void restore_state(void) override;
+
 private:
 	unsigned read_data(tlm::tlm_generic_payload &trans);
 	unsigned write_data(tlm::tlm_generic_payload &trans);
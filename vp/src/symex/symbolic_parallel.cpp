@@ -0,0 +1,672 @@
+/*
+ * Copyright (c) 2021 Group of Computer Architecture, University of Bremen
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <assert.h>
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#include <algorithm>
+#include <deque>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include "symbolic_parallel.h"
+
+// Time in milliseconds after which the coordinator re-checks
+// the stop predicate if no messages were received.
+#define POLL_TIMEOUT 1000
+
+enum MessageType : uint32_t {
+	MSG_IDLE,       /* worker → coordinator: local tree exhausted */
+	MSG_JOB,        /* coordinator → worker: explore given branch */
+	MSG_STEAL,      /* coordinator → worker: donate a branch */
+	MSG_DONATION,   /* worker → coordinator: donated branch */
+	MSG_NODONATION, /* worker → coordinator: nothing to donate */
+	MSG_TERMINATE,  /* coordinator → worker: stop exploration */
+	MSG_FINISHED,   /* worker → coordinator: statistics */
+	MSG_SOLVE,      /* explorer → solver: serialized query */
+	MSG_SOLUTION,   /* solver → explorer: input values, if sat */
+};
+
+struct MessageHeader {
+	uint32_t type;
+	uint32_t length; /* of payload following the header */
+	uint64_t arg0;
+	uint64_t arg1;
+};
+
+// A job is an unexplored branch of the execution tree, identified by
+// the input values which lead to it. The first depth branches on the
+// resulting path are owned by other workers and must not be negated.
+struct Job {
+	uint64_t depth;
+	std::string store;
+};
+
+struct Message {
+	MessageType type;
+	uint64_t arg0 = 0;
+	uint64_t arg1 = 0;
+	std::string payload;
+};
+
+struct Worker {
+	pid_t pid;
+	int fd;
+
+	bool busy = false;
+	bool steal_pending = false;
+};
+
+static int worker_fd = -1;
+static bool worker_started = false;
+static bool worker_terminated = false;
+
+static void
+write_all(int fd, const char *buf, size_t len)
+{
+	while (len > 0) {
+		ssize_t r = write(fd, buf, len);
+		if (r == -1) {
+			if (errno == EINTR)
+				continue;
+			throw std::system_error(errno, std::generic_category());
+		}
+
+		buf += r;
+		len -= (size_t)r;
+	}
+}
+
+// Returns false if the connection was closed before any data was read.
+static bool
+read_all(int fd, char *buf, size_t len)
+{
+	size_t total = 0;
+	while (total < len) {
+		ssize_t r = read(fd, buf + total, len - total);
+		if (r == -1) {
+			if (errno == EINTR)
+				continue;
+			throw std::system_error(errno, std::generic_category());
+		} else if (r == 0) {
+			if (total == 0)
+				return false;
+			throw std::runtime_error("truncated message from peer");
+		}
+
+		total += (size_t)r;
+	}
+
+	return true;
+}
+
+static void
+send_msg(int fd, MessageType type, uint64_t arg0 = 0, uint64_t arg1 = 0, std::string payload = "")
+{
+	MessageHeader hdr;
+
+	hdr.type = type;
+	hdr.length = payload.size();
+	hdr.arg0 = arg0;
+	hdr.arg1 = arg1;
+
+	write_all(fd, (char *)&hdr, sizeof(hdr));
+	write_all(fd, payload.data(), payload.size());
+}
+
+static std::optional<Message>
+recv_msg(int fd)
+{
+	MessageHeader hdr;
+	if (!read_all(fd, (char *)&hdr, sizeof(hdr)))
+		return std::nullopt;
+
+	Message msg;
+	msg.type = (MessageType)hdr.type;
+	msg.arg0 = hdr.arg0;
+	msg.arg1 = hdr.arg1;
+
+	msg.payload.resize(hdr.length);
+	if (hdr.length > 0 && !read_all(fd, msg.payload.data(), hdr.length))
+		throw std::runtime_error("truncated message from peer");
+
+	return msg;
+}
+
+static bool
+has_msg(int fd, int timeout)
+{
+	struct pollfd pfd;
+	pfd.fd = fd;
+	pfd.events = POLLIN;
+
+	int r = poll(&pfd, 1, timeout);
+	if (r == -1) {
+		if (errno == EINTR)
+			return false;
+		throw std::system_error(errno, std::generic_category());
+	}
+
+	return r > 0;
+}
+
+static std::vector<Worker> workers;
+
+int
+parallel_fork(unsigned jobs)
+{
+	assert(jobs > 0);
+
+	for (unsigned i = 0; i < jobs; i++) {
+		int fds[2];
+		if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == -1)
+			throw std::system_error(errno, std::generic_category());
+
+		pid_t pid = fork();
+		if (pid == -1) {
+			throw std::system_error(errno, std::generic_category());
+		} else if (pid == 0) {
+			// Sockets of previously forked workers are
+			// only needed by the coordinator.
+			for (auto &w : workers)
+				close(w.fd);
+			workers.clear();
+
+			close(fds[0]);
+			worker_fd = fds[1];
+			return (int)i;
+		}
+
+		close(fds[1]);
+
+		Worker w;
+		w.pid = pid;
+		w.fd = fds[0];
+		workers.push_back(w);
+	}
+
+	return -1;
+}
+
+static void
+kill_workers(void)
+{
+	for (auto &w : workers) {
+		kill(w.pid, SIGTERM);
+		waitpid(w.pid, NULL, 0);
+		close(w.fd);
+	}
+
+	workers.clear();
+}
+
+// Terminates the given worker and waits for its statistics.
+static bool
+terminate_worker(Worker &w, ParallelStats &stats)
+{
+	send_msg(w.fd, MSG_TERMINATE);
+
+	std::optional<Message> msg;
+	while ((msg = recv_msg(w.fd))) {
+		// Remaining messages (e.g. donations) are discarded.
+		if (msg->type == MSG_FINISHED)
+			break;
+	}
+	if (!msg.has_value())
+		return false;
+
+	stats.paths += msg->arg0;
+	stats.errors += msg->arg1;
+
+	int status;
+	if (waitpid(w.pid, &status, 0) == -1)
+		throw std::system_error(errno, std::generic_category());
+	close(w.fd);
+
+	return WIFEXITED(status) && WEXITSTATUS(status) == EXIT_SUCCESS;
+}
+
+// Invoked after all workers are idle or the stop predicate returned true.
+static bool
+terminate_workers(ParallelStats &stats)
+{
+	// Worker 0 merges the results of all other workers and
+	// must therefore be terminated last.
+	for (size_t i = workers.size(); i > 0; i--) {
+		if (!terminate_worker(workers.at(i - 1), stats)) {
+			workers.resize(i);
+			kill_workers();
+			return false;
+		}
+	}
+
+	workers.clear();
+	return true;
+}
+
+static bool
+handle_msg(Worker &w, Message &msg, std::deque<Job> &queue)
+{
+	switch (msg.type) {
+	case MSG_IDLE:
+		w.busy = false;
+		break;
+	case MSG_DONATION:
+		queue.push_back(Job{msg.arg0, msg.payload});
+		/* FALLTHROUGH */
+	case MSG_NODONATION:
+		w.steal_pending = false;
+		break;
+	default:
+		return false;
+	}
+
+	return true;
+}
+
+static void
+distribute(std::deque<Job> &queue)
+{
+	size_t idle = 0, pending = 0;
+	for (auto &w : workers) {
+		if (!w.busy && !queue.empty()) {
+			Job job = queue.front();
+			queue.pop_front();
+
+			send_msg(w.fd, MSG_JOB, job.depth, 0, job.store);
+			w.busy = true;
+		} else if (!w.busy) {
+			idle++;
+		}
+
+		if (w.steal_pending)
+			pending++;
+	}
+
+	// Ask busy workers to donate branches for the remaining idle ones.
+	for (auto &w : workers) {
+		if (pending >= idle)
+			break;
+		if (!w.busy || w.steal_pending)
+			continue;
+
+		send_msg(w.fd, MSG_STEAL);
+		w.steal_pending = true;
+		pending++;
+	}
+}
+
+static bool
+finished(std::deque<Job> &queue)
+{
+	if (!queue.empty())
+		return false;
+
+	for (auto &w : workers) {
+		if (w.busy || w.steal_pending)
+			return false;
+	}
+
+	return true;
+}
+
+bool
+parallel_coordinate(std::function<bool(void)> stop, ParallelStats &stats)
+{
+	std::deque<Job> queue;
+	queue.push_back(Job{0, ""}); /* start with random input values */
+
+	std::vector<struct pollfd> pfds(workers.size());
+	for (size_t i = 0; i < workers.size(); i++) {
+		pfds[i].fd = workers[i].fd;
+		pfds[i].events = POLLIN;
+	}
+
+	while (!finished(queue) && !stop()) {
+		distribute(queue);
+
+		int r = poll(pfds.data(), pfds.size(), POLL_TIMEOUT);
+		if (r == -1) {
+			if (errno == EINTR)
+				continue;
+			throw std::system_error(errno, std::generic_category());
+		}
+
+		for (size_t i = 0; r > 0 && i < pfds.size(); i++) {
+			if (!pfds[i].revents)
+				continue;
+
+			Worker &w = workers.at(i);
+			auto msg = recv_msg(w.fd);
+			if (!msg.has_value() || !handle_msg(w, *msg, queue)) {
+				kill_workers();
+				return false;
+			}
+		}
+	}
+
+	return terminate_workers(stats);
+}
+
+static void
+donate(clover::Trace &trace)
+{
+	size_t depth;
+	auto assign = trace.findNewPath(&depth);
+	if (!assign.has_value()) {
+		send_msg(worker_fd, MSG_NODONATION);
+		return;
+	}
+
+	std::stringstream ss;
+	clover::TestCase::toFile(trace.getStore(*assign), ss);
+
+	// The donated branch is marked as negated in our tree, all
+	// branches on the path leading to it are owned by us.
+	send_msg(worker_fd, MSG_DONATION, depth, 0, ss.str());
+}
+
+// Blocks until the coordinator assigns a new job to this worker.
+static bool
+wait_job(clover::ExecutionContext &ctx, clover::Trace &trace)
+{
+	std::optional<Message> msg;
+
+	while ((msg = recv_msg(worker_fd))) {
+		switch (msg->type) {
+		case MSG_STEAL:
+			send_msg(worker_fd, MSG_NODONATION);
+			break;
+		case MSG_TERMINATE:
+			worker_terminated = true;
+			return false;
+		case MSG_JOB: {
+			std::stringstream ss(msg->payload);
+			auto store = clover::TestCase::fromFile("job", ss);
+
+			trace.setExploredPrefix(msg->arg0);
+			return ctx.setupNewValues(store);
+		}
+		default:
+			break;
+		}
+	}
+
+	exit(EXIT_FAILURE); /* coordinator died */
+}
+
+bool
+parallel_next_path(clover::ExecutionContext &ctx, clover::Trace &trace)
+{
+	std::optional<Message> msg;
+
+	assert(worker_fd >= 0);
+	if (worker_terminated)
+		return false;
+
+	// All workers are initially considered idle by the coordinator.
+	if (!worker_started) {
+		worker_started = true;
+		return wait_job(ctx, trace);
+	}
+
+	while (has_msg(worker_fd, 0)) {
+		if (!(msg = recv_msg(worker_fd)))
+			exit(EXIT_FAILURE); /* coordinator died */
+
+		if (msg->type == MSG_STEAL) {
+			donate(trace);
+		} else if (msg->type == MSG_TERMINATE) {
+			worker_terminated = true;
+			return false;
+		}
+	}
+
+	if (ctx.setupNewValues(trace))
+		return true;
+
+	send_msg(worker_fd, MSG_IDLE);
+	return wait_job(ctx, trace);
+}
+
+void
+parallel_wait(void)
+{
+	std::optional<Message> msg;
+
+	assert(worker_fd >= 0);
+	if (worker_terminated)
+		return;
+
+	// Exploration may have stopped early (e.g. due to the time
+	// budget), the coordinator is not aware of this yet.
+	if (worker_started)
+		send_msg(worker_fd, MSG_IDLE);
+
+	while ((msg = recv_msg(worker_fd))) {
+		switch (msg->type) {
+		case MSG_STEAL:
+			send_msg(worker_fd, MSG_NODONATION);
+			break;
+		case MSG_JOB:
+			send_msg(worker_fd, MSG_IDLE);
+			break;
+		case MSG_TERMINATE:
+			worker_terminated = true;
+			return;
+		default:
+			break;
+		}
+	}
+
+	exit(EXIT_FAILURE); /* coordinator died */
+}
+
+void
+parallel_report(const ParallelStats &stats)
+{
+	assert(worker_fd >= 0);
+
+	send_msg(worker_fd, MSG_FINISHED, stats.paths, stats.errors);
+	close(worker_fd);
+	worker_fd = -1;
+}
+
+// Amount of queries sent to a solver process whose results have not
+// been received yet. Allows solvers to start with the next query
+// immediately, without waiting for the explorer.
+#define SOLVER_QUEUE_LENGTH 2
+
+struct SolverProcess {
+	pid_t pid;
+	int fd;
+
+	size_t queued = 0;
+};
+
+struct Solution {
+	uint64_t id;
+	std::optional<std::string> store;
+};
+
+static std::vector<SolverProcess> solvers;
+static std::deque<Solution> solutions;
+
+static void
+solver_loop(clover::Solver &solver, int fd)
+{
+	std::optional<Message> msg;
+
+	while ((msg = recv_msg(fd))) {
+		if (msg->type != MSG_SOLVE)
+			continue;
+
+		std::optional<clover::ConcreteStore> store;
+		try {
+			store = solver.solveSerialized(msg->payload);
+		} catch (const std::exception &e) {
+			// Treated as unsat, the branch is not negated again.
+			std::cerr << "WARNING: Solver failed: " << e.what() << std::endl;
+		}
+
+		std::stringstream ss;
+		if (store.has_value())
+			clover::TestCase::toFile(*store, ss);
+		send_msg(fd, MSG_SOLUTION, msg->arg0, store.has_value(), ss.str());
+	}
+}
+
+void
+pipeline_fork(clover::Solver &solver, unsigned count)
+{
+	assert(count > 0 && solvers.empty());
+
+	for (unsigned i = 0; i < count; i++) {
+		int fds[2];
+		if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == -1)
+			throw std::system_error(errno, std::generic_category());
+
+		pid_t pid = fork();
+		if (pid == -1) {
+			throw std::system_error(errno, std::generic_category());
+		} else if (pid == 0) {
+			for (auto &s : solvers)
+				close(s.fd);
+			close(fds[0]);
+
+			// Terminates once the explorer closed the socket. Exit
+			// handlers (e.g. writing coverage) belong to the explorer.
+			solver_loop(solver, fds[1]);
+			_exit(EXIT_SUCCESS);
+		}
+		close(fds[1]);
+
+		SolverProcess s;
+		s.pid = pid;
+		s.fd = fds[0];
+		solvers.push_back(s);
+	}
+}
+
+static void
+dispatch_queries(clover::Trace &trace)
+{
+	for (;;) {
+		auto s = std::min_element(solvers.begin(), solvers.end(),
+			[](const SolverProcess &a, const SolverProcess &b) { return a.queued < b.queued; });
+		if (s->queued >= SOLVER_QUEUE_LENGTH)
+			break;
+
+		auto query = trace.takePending();
+		if (!query.has_value())
+			break; /* frontier is empty */
+
+		send_msg(s->fd, MSG_SOLVE, query->first, 0, query->second);
+		s->queued++;
+	}
+}
+
+// Receives available solutions, blocks until at least one
+// solution has been received if wait is true.
+static void
+receive_solutions(bool wait)
+{
+	std::vector<struct pollfd> pfds(solvers.size());
+	for (size_t i = 0; i < solvers.size(); i++) {
+		pfds[i].fd = solvers[i].fd;
+		pfds[i].events = POLLIN;
+	}
+
+	int r = poll(pfds.data(), pfds.size(), (wait) ? -1 : 0);
+	if (r == -1) {
+		if (errno == EINTR)
+			return;
+		throw std::system_error(errno, std::generic_category());
+	}
+
+	for (size_t i = 0; r > 0 && i < pfds.size(); i++) {
+		if (!pfds[i].revents)
+			continue;
+
+		SolverProcess &s = solvers.at(i);
+		auto msg = recv_msg(s.fd);
+		if (!msg.has_value() || msg->type != MSG_SOLUTION)
+			throw std::runtime_error("solver process terminated unexpectedly");
+
+		Solution sol;
+		sol.id = msg->arg0;
+		if (msg->arg1)
+			sol.store = msg->payload;
+
+		solutions.push_back(sol);
+		s.queued--;
+	}
+}
+
+bool
+pipeline_next_path(clover::ExecutionContext &ctx, clover::Trace &trace)
+{
+	for (;;) {
+		dispatch_queries(trace);
+		receive_solutions(false);
+
+		while (!solutions.empty()) {
+			Solution sol = solutions.front();
+			solutions.pop_front();
+
+			if (!trace.finishPending(sol.id, sol.store.has_value()))
+				continue;
+
+			// Solvers continue while the next path is executed.
+			dispatch_queries(trace);
+
+			std::stringstream ss(*sol.store);
+			return ctx.setupNewValues(clover::TestCase::fromFile("solution", ss));
+		}
+
+		bool busy = std::any_of(solvers.begin(), solvers.end(),
+			[](const SolverProcess &s) { return s.queued > 0; });
+		if (!busy)
+			return false; /* all branches exhausted */
+
+		receive_solutions(true);
+	}
+}
+
+void
+pipeline_stop(void)
+{
+	for (auto &s : solvers) {
+		close(s.fd);
+		kill(s.pid, SIGTERM);
+		waitpid(s.pid, NULL, 0);
+	}
+
+	solvers.clear();
+	solutions.clear();
+}
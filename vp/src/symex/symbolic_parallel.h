@@ -0,0 +1,74 @@
+/*
+ * Copyright (c) 2021 Group of Computer Architecture, University of Bremen
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef RISCV_ISA_SYMBOLIC_PARALLEL_H
+#define RISCV_ISA_SYMBOLIC_PARALLEL_H
+
+#include <stddef.h>
+#include <stdbool.h>
+
+#include <functional>
+
+#include <clover/clover.h>
+
+// Parallel path exploration using forked worker processes. Each
+// worker explores a disjoint part of the execution tree. Initially,
+// a single worker owns the entire tree, idle workers obtain work by
+// stealing unexplored branches from busy workers. The coordinator
+// (i.e. the parent process) only relays messages between workers.
+
+struct ParallelStats {
+	size_t paths = 0;
+	size_t errors = 0;
+};
+
+// Forks the given amount of workers. Returns the id of the worker in
+// each worker process and a negative value in the coordinator.
+int parallel_fork(unsigned jobs);
+
+// Distributes work between workers until the execution tree has been
+// explored or the given predicate returns true. Afterwards, workers
+// are terminated in reverse order, i.e. worker 0 terminates last.
+// Returns false if a worker terminated unexpectedly.
+bool parallel_coordinate(std::function<bool(void)> stop, ParallelStats &stats);
+
+// Invoked by a worker to setup the concrete values for the next path.
+// Answers pending work stealing requests and obtains new work from
+// the coordinator once the local part of the tree is exhausted.
+// Returns false if the worker should terminate.
+bool parallel_next_path(clover::ExecutionContext &ctx, clover::Trace &trace);
+
+// Invoked by a worker after exploration finished, blocks until the
+// coordinator requests termination of the worker.
+void parallel_wait(void);
+
+// Reports statistics of a terminating worker to the coordinator.
+void parallel_report(const ParallelStats &stats);
+
+// Pipelined exploration, queries for new paths are solved by forked
+// solver processes while the current path is executed. Several frontier
+// nodes are negated speculatively to keep all solver processes busy.
+void pipeline_fork(clover::Solver &solver, unsigned count);
+
+// Alternative to ExecutionContext::setupNewValues(Trace &) in pipelined
+// mode, only blocks if no solution is available yet.
+bool pipeline_next_path(clover::ExecutionContext &ctx, clover::Trace &trace);
+
+// Terminates all solver processes.
+void pipeline_stop(void);
+
+#endif
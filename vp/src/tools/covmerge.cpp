@@ -0,0 +1,137 @@
+/*
+ * Copyright (c) 2021 Group of Computer Architecture, University of Bremen
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+// Merges binary coverage dumps (see SYMEX_COVERAGE_DUMP) of multiple
+// runs and writes the result as dump, gcov JSON, or gcovr JSON.
+
+#include <stdlib.h>
+
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <boost/iostreams/filtering_streambuf.hpp>
+#include <boost/iostreams/filter/gzip.hpp>
+#include <boost/program_options.hpp>
+
+#include "core/rv32/coverage_dump.h"
+#include "core/rv32/json_writer.h"
+
+namespace po = boost::program_options;
+using namespace rv32;
+
+struct Options {
+	std::vector<std::string> inputs;
+	std::string output;
+	std::string format = "gcov";
+	std::string prefix;
+	bool compact = false;
+};
+
+static Options
+parse_options(int argc, char **argv) {
+	Options opt;
+
+	po::options_description desc("Usage: covmerge [OPTION]... DUMP...");
+	// clang-format off
+	desc.add_options()
+		("help", "produce help message")
+		("output,o", po::value<std::string>(&opt.output), "output file, compressed if it ends with .gz (default: stdout)")
+		("format,f", po::value<std::string>(&opt.format), "output format: dump, gcov, or gcovr (default: gcov)")
+		("prefix,p", po::value<std::string>(&opt.prefix), "only convert source files with this path prefix")
+		("compact,c", po::bool_switch(&opt.compact), "write JSON without indentation")
+		("input-file", po::value<std::vector<std::string>>(&opt.inputs)->required(), "coverage dump to merge");
+	// clang-format on
+
+	po::positional_options_description pos;
+	pos.add("input-file", -1);
+
+	try {
+		po::variables_map vm;
+		po::store(po::command_line_parser(argc, argv).options(desc).positional(pos).run(), vm);
+
+		if (vm.count("help")) {
+			std::cout << desc << std::endl;
+			exit(EXIT_SUCCESS);
+		}
+
+		po::notify(vm);
+		if (opt.format != "dump" && opt.format != "gcov" && opt.format != "gcovr")
+			throw po::error("unknown output format '" + opt.format + "'");
+	} catch (po::error &e) {
+		std::cerr
+			<< "Error parsing command line options: "
+			<< e.what()
+			<< std::endl;
+		exit(EXIT_FAILURE);
+	}
+
+	return opt;
+}
+
+static void
+write_output(Options &opt, CoverageDump &dump, std::ostream &out) {
+	if (opt.format == "dump") {
+		dump.write(out);
+		return;
+	}
+
+	JsonWriter json(out, (opt.compact) ? 0 : 4);
+	if (opt.format == "gcov") {
+		dump.to_gcov(json, opt.prefix);
+	} else {
+		dump.to_gcovr(json, opt.prefix);
+	}
+	out << std::endl;
+}
+
+int main(int argc, char **argv) {
+	Options opt = parse_options(argc, argv);
+
+	try {
+		// Counters of all dumps are added to the first one.
+		CoverageDump merged(opt.inputs.front());
+		for (size_t i = 1; i < opt.inputs.size(); i++) {
+			CoverageDump dump(opt.inputs.at(i));
+			merged.merge(dump);
+		}
+
+		if (opt.output.empty()) {
+			write_output(opt, merged, std::cout);
+			return EXIT_SUCCESS;
+		}
+
+		std::ofstream fout(opt.output, std::ios::binary);
+		if (!fout.is_open())
+			throw std::runtime_error("failed to open " + opt.output);
+
+		boost::iostreams::filtering_streambuf<boost::iostreams::output> outbuf;
+		if (opt.output.size() > 3 && opt.output.compare(opt.output.size() - 3, 3, ".gz") == 0)
+			outbuf.push(boost::iostreams::gzip_compressor());
+		outbuf.push(fout);
+
+		std::ostream out(&outbuf);
+		write_output(opt, merged, out);
+	} catch (const std::exception &e) {
+		std::cerr << "covmerge: " << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}